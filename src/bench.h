@@ -0,0 +1,374 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef __linux__
+#	include <cerrno>
+#	include <linux/perf_event.h>
+#	include <sys/ioctl.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif
+
+#include "float_utils/decimal.h"
+#include "float_utils/float_parts.h"
+#include "float_utils/instrumentation.h"
+#include "float_utils/utils.h"
+
+// Operands for benchmarking a binary operator
+struct benchmark_inputs {
+	std::vector<float> xs;
+	std::vector<float> ys;
+};
+
+// Generates inputs using the given generator, keeping only pairs for which the reference operator produces a result
+// that passes the filter
+template <typename Gen, typename Op, typename Filter> benchmark_inputs generate_benchmark_inputs(
+	Gen &&gen, Op &&ref_op, Filter &&filter, std::size_t count
+) {
+	benchmark_inputs result;
+	result.xs.reserve(count);
+	result.ys.reserve(count);
+	while (result.xs.size() < count) {
+		const float x = gen();
+		const float y = gen();
+		if (filter(ref_op(x, y))) {
+			result.xs.emplace_back(x);
+			result.ys.emplace_back(y);
+		}
+	}
+	return result;
+}
+
+// Hardware events counted around benchmarked kernels
+enum class perf_event : std::uint32_t {
+	cycles,
+	instructions,
+	branches,
+	branch_misses,
+	l1d_read_misses,
+
+	count
+};
+constexpr std::size_t num_perf_events = static_cast<std::size_t>(perf_event::count);
+
+// Hardware performance counters of the calling thread, read using perf_event_open on Linux. The events are opened as
+// one group, so that they are always scheduled together and ratios between them are taken over the same time. Events
+// that cannot be opened, e.g. because of permissions or because the machine is virtualized, are reported as
+// unavailable
+class perf_counters {
+public:
+	using values = std::array<std::optional<std::uint64_t>, num_perf_events>;
+
+	perf_counters() {
+		_fds.fill(-1);
+#ifdef __linux__
+		constexpr std::array<std::pair<std::uint32_t, std::uint64_t>, num_perf_events> events{
+			std::pair<std::uint32_t, std::uint64_t>(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES),
+			std::pair<std::uint32_t, std::uint64_t>(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS),
+			std::pair<std::uint32_t, std::uint64_t>(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS),
+			std::pair<std::uint32_t, std::uint64_t>(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES),
+			std::pair<std::uint32_t, std::uint64_t>(
+				PERF_TYPE_HW_CACHE,
+				PERF_COUNT_HW_CACHE_L1D |
+				(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+				(PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+			)
+		};
+		for (std::size_t i = 0; i < num_perf_events; ++i) {
+			perf_event_attr attr;
+			std::memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = events[i].first;
+			attr.config = events[i].second;
+			// The first event that can be opened leads the group; the others are started and stopped with it
+			attr.disabled = _leader < 0 ? 1 : 0;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			// Used to scale the counts when the kernel multiplexes the group with other events
+			attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			_fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, _leader, 0));
+			if (_fds[i] >= 0 && _leader < 0) {
+				_leader = _fds[i];
+			}
+			if (_fds[i] < 0 && _error.empty()) {
+				_error = std::string("perf_event_open failed: ") + std::strerror(errno);
+			}
+		}
+#else
+		_error = "hardware counters are only supported on Linux";
+#endif
+	}
+	perf_counters(const perf_counters&) = delete;
+	perf_counters &operator=(const perf_counters&) = delete;
+	~perf_counters() {
+#ifdef __linux__
+		// Members are closed before the leader of the group
+		for (const int fd : _fds) {
+			if (fd >= 0 && fd != _leader) {
+				close(fd);
+			}
+		}
+		if (_leader >= 0) {
+			close(_leader);
+		}
+#endif
+	}
+
+	[[nodiscard]] bool is_available(perf_event event) const {
+		return _fds[static_cast<std::size_t>(event)] >= 0;
+	}
+	// Returns the reason why the first unavailable event could not be opened, or an empty string if all are available
+	[[nodiscard]] std::string_view get_error() const {
+		return _error;
+	}
+
+	// Resets and starts all available counters
+	void start() {
+#ifdef __linux__
+		if (_leader >= 0) {
+			ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+			ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+#endif
+	}
+	// Stops all counters and returns their values since the last call to start()
+	[[nodiscard]] values stop() {
+		values result;
+#ifdef __linux__
+		if (_leader < 0) {
+			return result;
+		}
+		ioctl(_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		// The number of events, the times that the group has been enabled and running, then the value of each event in
+		// the order they have been added to the group
+		std::array<std::uint64_t, 3 + num_perf_events> data{};
+		const ssize_t size = read(_leader, data.data(), sizeof(data));
+		const std::uint64_t num_events = data[0];
+		if (size < 0 || static_cast<std::size_t>(size) != (3 + num_events) * sizeof(std::uint64_t) || data[2] == 0) {
+			return result;
+		}
+		std::size_t group_index = 0;
+		for (std::size_t i = 0; i < num_perf_events; ++i) {
+			if (_fds[i] < 0) {
+				continue;
+			}
+			if (group_index < num_events) {
+				result[i] = static_cast<std::uint64_t>(
+					static_cast<double>(data[3 + group_index]) * static_cast<double>(data[1]) / static_cast<double>(data[2])
+				);
+			}
+			++group_index;
+		}
+#endif
+		return result;
+	}
+private:
+	std::array<int, num_perf_events> _fds;
+	int _leader = -1; // File descriptor of the group leader, or -1 if no event could be opened
+	std::string _error;
+};
+
+// Timing and hardware counters of a benchmark run
+struct benchmark_result {
+	double ns_per_op = 0.0;
+	std::uint64_t num_ops = 0;
+	perf_counters::values counters;
+
+	[[nodiscard]] std::optional<double> get_per_op(perf_event event) const {
+		const std::optional<std::uint64_t> &value = counters[static_cast<std::size_t>(event)];
+		if (!value) {
+			return std::nullopt;
+		}
+		return static_cast<double>(value.value()) / static_cast<double>(num_ops);
+	}
+	// Returns the ratio between two counters, or std::nullopt if either is unavailable or the denominator is zero
+	[[nodiscard]] std::optional<double> get_ratio(perf_event numerator, perf_event denominator) const {
+		const std::optional<std::uint64_t> &num = counters[static_cast<std::size_t>(numerator)];
+		const std::optional<std::uint64_t> &denom = counters[static_cast<std::size_t>(denominator)];
+		if (!num || !denom || denom.value() == 0) {
+			return std::nullopt;
+		}
+		return static_cast<double>(num.value()) / static_cast<double>(denom.value());
+	}
+};
+
+// Measures the average time of one operation, and the hardware counters if they are available
+template <typename Op> benchmark_result benchmark_binary_float_operator(
+	Op &&op, const benchmark_inputs &inputs, std::uint32_t repeats, perf_counters &counters
+) {
+	// Accumulate all results so that the operations cannot be optimized away
+	std::uint32_t sink = 0;
+	counters.start();
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint32_t r = 0; r < repeats; ++r) {
+		for (std::size_t i = 0; i < inputs.xs.size(); ++i) {
+			sink ^= std::bit_cast<std::uint32_t>(op(inputs.xs[i], inputs.ys[i]));
+		}
+	}
+	const auto end = std::chrono::steady_clock::now();
+	benchmark_result result;
+	result.counters = counters.stop();
+	volatile std::uint32_t sink_out = sink;
+	static_cast<void>(sink_out);
+
+	const std::chrono::duration<double, std::nano> duration = end - start;
+	result.num_ops = static_cast<std::uint64_t>(repeats) * inputs.xs.size();
+	result.ns_per_op = duration.count() / static_cast<double>(result.num_ops);
+	return result;
+}
+
+// Prints one line of the benchmark report. Hardware counters are only printed if at least one of them is available,
+// and counters that are unavailable are printed as "n/a"
+inline void print_benchmark_result(std::string_view name, const benchmark_result &result) {
+	std::cout << name << result.ns_per_op << " ns/op";
+	bool any_counter = false;
+	for (const std::optional<std::uint64_t> &value : result.counters) {
+		any_counter = any_counter || value.has_value();
+	}
+	if (any_counter) {
+		auto print_value = [](std::optional<double> value, double scale, std::string_view unit) {
+			std::cout << ", ";
+			if (value) {
+				std::cout << value.value() * scale;
+			} else {
+				std::cout << "n/a";
+			}
+			std::cout << unit;
+		};
+		print_value(result.get_per_op(perf_event::cycles), 1.0, " cycles/op");
+		print_value(result.get_ratio(perf_event::instructions, perf_event::cycles), 1.0, " IPC");
+		print_value(result.get_ratio(perf_event::branch_misses, perf_event::branches), 100.0, "% branches mispredicted");
+		print_value(result.get_per_op(perf_event::l1d_read_misses), 1.0, " L1D misses/op");
+	}
+	std::cout << "\n";
+}
+
+// Benchmarks the hardware and software versions of an operator on the same inputs and prints the timings, along with
+// hardware counters if they are available
+template <typename SysOp, typename MyOp> void benchmark_binary_float_operator_pair(
+	SysOp &&sys_ver, MyOp &&my_ver, const benchmark_inputs &inputs, std::string_view test_name
+) {
+	constexpr std::uint32_t repeats = 100;
+	perf_counters counters;
+	const benchmark_result sys_result = benchmark_binary_float_operator(sys_ver, inputs, repeats, counters);
+	const benchmark_result my_result = benchmark_binary_float_operator(my_ver, inputs, repeats, counters);
+	std::cout << test_name << ":\n";
+	print_benchmark_result("  Hardware: ", sys_result);
+	print_benchmark_result("        My: ", my_result);
+	static bool reported_error = false;
+	if (!counters.get_error().empty() && !reported_error) {
+		std::cout << "  Some hardware counters are unavailable (" << counters.get_error() << ")\n";
+		reported_error = true;
+	}
+}
+
+// Error of an approximation relative to a reference, measured over many inputs
+struct approximation_error {
+	std::uint64_t num_tested = 0;
+	std::uint64_t num_exact = 0; // Bitwise identical to the reference
+	std::uint64_t max_ulps = 0;
+	float max_ulps_input = 0.0f;
+	double max_relative = 0.0;
+};
+
+// Measures the error of a function of one float against a correctly rounded reference over all positive normal floats
+// for which the reference produces a normal result
+template <typename Func, typename Ref> [[nodiscard]] approximation_error measure_unary_float_function_error(
+	Func &&func, Ref &&ref
+) {
+	approximation_error error;
+	constexpr std::uint32_t max_normal = float_parts::exponent_mask - 1;
+	for (std::uint32_t i = 1u << float_parts::num_fraction_bits; i <= max_normal; ++i) {
+		const float x = std::bit_cast<float>(i);
+		const float expected = ref(x);
+		if (!std::isnormal(expected)) {
+			continue;
+		}
+		const float actual = func(x);
+		++error.num_tested;
+		// Positive and negative results are compared by their distance on the number line
+		auto to_ordered = [](float f) {
+			const auto bits = static_cast<std::int64_t>(std::bit_cast<std::uint32_t>(f) & ~float_parts::sign_mask);
+			return std::signbit(f) ? -bits : bits;
+		};
+		const std::uint64_t ulps = std::isnan(actual) ?
+			std::numeric_limits<std::uint64_t>::max() :
+			static_cast<std::uint64_t>(std::abs(to_ordered(actual) - to_ordered(expected)));
+		if (ulps == 0) {
+			++error.num_exact;
+		} else if (ulps > error.max_ulps) {
+			error.max_ulps = ulps;
+			error.max_ulps_input = x;
+		}
+		error.max_relative = std::max(
+			error.max_relative,
+			std::abs((static_cast<double>(actual) - static_cast<double>(expected)) / static_cast<double>(expected))
+		);
+	}
+	return error;
+}
+
+// Benchmarks a function of one float on the given inputs, measures its error against the reference, and prints both
+template <typename Func, typename Ref> void report_unary_float_function(
+	Func &&func, Ref &&ref, const std::vector<float> &inputs, std::string_view name
+) {
+	constexpr std::uint32_t repeats = 100;
+	perf_counters counters;
+	const benchmark_inputs binary_inputs{ inputs, inputs };
+	const benchmark_result result = benchmark_binary_float_operator(
+		[&](float x, float) { return func(x); }, binary_inputs, repeats, counters
+	);
+	const approximation_error error = measure_unary_float_function_error(func, ref);
+
+	print_benchmark_result(name, result);
+	std::cout <<
+		std::string(name.size(), ' ') << "max " << error.max_ulps << " ulps at " << error.max_ulps_input <<
+		", max relative error " << error.max_relative << ", " <<
+		100.0 * static_cast<double>(error.num_exact) / static_cast<double>(error.num_tested) << "% exact\n";
+}
+
+// Runs an operator instrumented with float_utils::path_counters once over all inputs, and prints how often each of
+// its internal paths is taken
+template <typename ProfiledOp> void profile_binary_float_operator_paths(
+	ProfiledOp &&profiled_ver, const benchmark_inputs &inputs, std::string_view operator_name, std::string_view test_name
+) {
+	float_utils::path_counters::reset();
+	std::uint32_t sink = 0;
+	for (std::size_t i = 0; i < inputs.xs.size(); ++i) {
+		sink ^= std::bit_cast<std::uint32_t>(profiled_ver(inputs.xs[i], inputs.ys[i]));
+	}
+	volatile std::uint32_t sink_out = sink;
+	static_cast<void>(sink_out);
+
+	std::cout << test_name << " paths over " << inputs.xs.size() << " operations:\n";
+	float_utils::path_counters::write_report(std::cout, operator_name);
+}
+
+// Prompts for a float on standard input until a valid decimal number is entered. The number is correctly rounded to
+// nearest, so that the same float is obtained as when it is printed using float_utils::to_string(). Returns
+// std::nullopt at the end of the input
+[[nodiscard]] inline std::optional<float> read_float(std::string_view prompt) {
+	for (std::string line; std::cout << prompt && std::getline(std::cin, line); ) {
+		float value = 0.0f;
+		const std::from_chars_result result = float_utils::from_chars(line.data(), line.data() + line.size(), value);
+		if (result.ec != std::errc::invalid_argument && result.ptr == line.data() + line.size()) {
+			return value;
+		}
+		std::cout << "Invalid number: " << line << "\n";
+	}
+	return std::nullopt;
+}
@@ -1,17 +1,59 @@
 #include <iostream>
+#include <limits>
 
 #include "float_utils/add.h"
 
 #include "fuzz.h"
 
-constexpr auto rounding_mode = float_utils::rounding_mode::nearest_tie_to_even;
+// Compile-time edge cases
+namespace add_vectors {
+	using float_utils::add;
+	using float_utils::sub;
+	using enum float_utils::rounding_mode;
 
-int main() {
-	std::fesetround(float_utils::to_fe_rounding_mode(rounding_mode));
-	fuzz_binary_float_operator(
+	constexpr float max = std::numeric_limits<float>::max();
+	constexpr float inf = std::numeric_limits<float>::infinity();
+
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(1.0f, 1.0f), 2.0f));
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(0.0f, 1.5f), 1.5f));
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(-1.5f, 0.25f), -1.25f));
+	static_assert(bitwise_equal(sub<nearest_tie_to_even>(1.0f, 1.0f), 0.0f));
+	static_assert(bitwise_equal(sub<nearest_tie_to_even>(1.0f, 0x1p-24f), 0x1.fffffep-1f));
+	// Ties
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(1.0f, 0x1p-24f), 1.0f));
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(0x1.000002p0f, 0x1p-24f), 0x1.000004p0f));
+	static_assert(bitwise_equal(add<nearest_tie_to_infinity>(1.0f, 0x1p-24f), 0x1.000002p0f));
+	// Directed rounding
+	static_assert(bitwise_equal(add<upward>(1.0f, 0x1p-30f), 0x1.000002p0f));
+	static_assert(bitwise_equal(add<downward>(1.0f, 0x1p-30f), 1.0f));
+	static_assert(bitwise_equal(add<downward>(-1.0f, -0x1p-30f), -0x1.000002p0f));
+	static_assert(bitwise_equal(add<toward_zero>(-1.0f, -0x1p-30f), -1.0f));
+	// Overflow
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(max, max), inf));
+	static_assert(bitwise_equal(add<toward_zero>(max, max), max));
+	static_assert(bitwise_equal(add<downward>(max, max), max));
+	static_assert(bitwise_equal(add<downward>(-max, -max), -inf));
+	static_assert(bitwise_equal(add<upward>(-max, -max), -max));
+	// Zeros and subnormals
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(-0.0f, -0.0f), -0.0f));
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(0.0f, -0.0f), 0.0f));
+	static_assert(bitwise_equal(add<downward>(0.0f, -0.0f), -0.0f));
+	static_assert(bitwise_equal(sub<downward>(1.0f, 1.0f), -0.0f));
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(0x1p-149f, 0x1p-149f), 0x1p-148f));
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(0x1.fffffcp-127f, 0x1p-149f), 0x1p-126f));
+	static_assert(bitwise_equal(sub<nearest_tie_to_even>(0x1p-126f, 0x1.000002p-126f), -0x1p-149f));
+	static_assert(bitwise_equal(add<nearest_tie_to_even>(1.0f, 0x1p-149f), 1.0f));
+	static_assert(bitwise_equal(add<upward>(1.0f, 0x1p-149f), 0x1.000002p0f));
+	// Instrumented versions can still be evaluated at compile time
+	static_assert(bitwise_equal(add<nearest_tie_to_even, float_utils::path_counters>(0x1p-126f, -0x1p-126f), 0.0f));
+}
+
+int main(int argc, char **argv) {
+	return fuzz_main(
+		argc, argv,
+		fuzz_operator::add,
 		[](float x, float y) { return x + y; },
-		float_utils::add<rounding_mode>,
+		[]<float_utils::rounding_mode Mode>() { return float_utils::add<Mode, float_utils::path_counters>; },
 		"add"
 	);
-	return 0;
 }
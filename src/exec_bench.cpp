@@ -0,0 +1,66 @@
+#include <iostream>
+#include <random>
+
+#include "float_utils/add.h"
+#include "float_utils/category.h"
+#include "float_utils/div.h"
+#include "float_utils/mul.h"
+
+#include "bench.h"
+
+constexpr auto rounding_mode = float_utils::rounding_mode::nearest_tie_to_even;
+constexpr std::size_t num_inputs = 1 << 16;
+
+template <typename SysOp, typename MyOp, typename ProfiledOp> void benchmark(
+	SysOp &&sys_ver, MyOp &&my_ver, ProfiledOp &&profiled_ver, std::string_view test_name
+) {
+	std::default_random_engine rng(12345);
+
+	// Normal inputs producing normal results, which should all take the fast path
+	const benchmark_inputs normal_inputs = generate_benchmark_inputs(
+		[&]() { return float_utils::random_normal_float(rng); },
+		sys_ver,
+		[](float res) { return std::isnormal(res); },
+		num_inputs
+	);
+	benchmark_binary_float_operator_pair(sys_ver, my_ver, normal_inputs, std::string(test_name) + " (normal)");
+	profile_binary_float_operator_paths(profiled_ver, normal_inputs, test_name, std::string(test_name) + " (normal)");
+
+	// Operands that are either tiny or close to 1, producing subnormal results
+	std::uniform_int_distribution<std::uint32_t> tiny_dist(0u, 2u << float_parts::num_fraction_bits);
+	std::uniform_int_distribution<std::uint32_t> unit_dist(0x3E800000u, 0x40800000u); // [0.25, 4]
+	std::uniform_int_distribution<std::uint32_t> choice_dist(0u, 3u);
+	const benchmark_inputs subnormal_inputs = generate_benchmark_inputs(
+		[&]() {
+			const std::uint32_t choice = choice_dist(rng);
+			const std::uint32_t bits = (choice & 1u) ? tiny_dist(rng) : unit_dist(rng);
+			return std::bit_cast<float>(bits | ((choice & 2u) ? float_parts::sign_mask : 0u));
+		},
+		sys_ver,
+		[](float res) { return float_utils::is_subnormal(res); },
+		num_inputs
+	);
+	benchmark_binary_float_operator_pair(sys_ver, my_ver, subnormal_inputs, std::string(test_name) + " (subnormal)");
+	profile_binary_float_operator_paths(profiled_ver, subnormal_inputs, test_name, std::string(test_name) + " (subnormal)");
+}
+
+int main() {
+	std::fesetround(float_utils::to_fe_rounding_mode(rounding_mode));
+	using float_utils::path_counters;
+	benchmark(
+		[](float x, float y) { return x + y; },
+		float_utils::add<rounding_mode>, float_utils::add<rounding_mode, path_counters>,
+		"add"
+	);
+	benchmark(
+		[](float x, float y) { return x * y; },
+		float_utils::mul<rounding_mode>, float_utils::mul<rounding_mode, path_counters>,
+		"mul"
+	);
+	benchmark(
+		[](float x, float y) { return x / y; },
+		float_utils::div<rounding_mode>, float_utils::div<rounding_mode, path_counters>,
+		"div"
+	);
+	return 0;
+}
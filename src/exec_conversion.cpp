@@ -1,57 +1,232 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "float_utils/conversions.h"
 
-int main() {
-	// int to float conversion
-	for (std::int32_t i = -std::numeric_limits<std::int32_t>::min(); ; ++i) {
-		const float hw_f = static_cast<float>(i);
-		const float my_f = float_utils::to_float(i);
+#include "shard.h"
+#include "telemetry.h"
 
-		if (std::bit_cast<std::uint32_t>(hw_f) != std::bit_cast<std::uint32_t>(my_f)) {
-			std::cout <<
-				"Not equal: " << i << "\n" <<
-				"Hardware conversion: " << hw_f << " " << std::bit_cast<std::uint32_t>(hw_f) << "\n" <<
-				"      My conversion: " << my_f << " " << std::bit_cast<std::uint32_t>(my_f) << "\n" <<
-				"----------\n";
+constexpr std::size_t batch_size = 4096;
+
+template <typename Int> [[nodiscard]] constexpr std::string_view get_integer_type_name() {
+	if constexpr (std::is_signed_v<Int>) {
+		return sizeof(Int) == 4 ? "int32" : "int64";
+	} else {
+		return sizeof(Int) == 4 ? "uint32" : "uint64";
+	}
+}
+
+// Tests int to float conversion against hardware. 32-bit integers are tested exhaustively, and 64-bit integers are
+// tested using random values of all magnitudes
+template <float_utils::rounding_mode RoundingMode, typename Int> shard_result test_to_float(const shard_spec &spec) {
+	shard_result result = create_result(
+		spec, "to_float_" + std::string(get_integer_type_name<Int>()), std::string(get_rounding_mode_name(RoundingMode)),
+		1ull << 32
+	);
+	std::fesetround(float_utils::to_fe_rounding_mode(RoundingMode));
+
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+	std::array<Int, batch_size> ints;
+	std::array<float, batch_size> my_floats;
+	auto test_batch = [&](std::size_t count) {
+		float_utils::to_float_batch<RoundingMode>(
+			std::span<const Int>(ints.data(), count), std::span<float>(my_floats.data(), count)
+		);
+		for (std::size_t i = 0; i < count; ++i) {
+			const float hw_f = static_cast<float>(ints[i]);
+			if (std::bit_cast<std::uint32_t>(hw_f) != std::bit_cast<std::uint32_t>(my_floats[i])) {
+				std::cout <<
+					"Not equal: " << ints[i] << "\n" <<
+					"Hardware conversion: " << hw_f << " " << std::bit_cast<std::uint32_t>(hw_f) << "\n" <<
+					"      My conversion: " << my_floats[i] << " " << std::bit_cast<std::uint32_t>(my_floats[i]) << "\n" <<
+					"----------\n";
+				std::ostringstream failure;
+				failure <<
+					ints[i] << " " << std::hex <<
+					std::bit_cast<std::uint32_t>(hw_f) << " " << std::bit_cast<std::uint32_t>(my_floats[i]);
+				result.add_failure(failure.str());
+				counters.add_mismatch();
+			}
 		}
+		counters.add_samples(count);
+	};
 
-		if (i % 100000000 == 0) {
-			std::cout << "int -> float: Tested " << i << "\n";
+	// Each shard uses a different random sequence for 64-bit integers
+	std::seed_seq seed_seq{
+		static_cast<std::uint32_t>(spec.seed), static_cast<std::uint32_t>(spec.seed >> 32),
+		static_cast<std::uint32_t>(result.begin), static_cast<std::uint32_t>(result.begin >> 32)
+	};
+	std::default_random_engine rng(seed_seq);
+	std::uniform_int_distribution<std::uint64_t> value_dist;
+	std::uniform_int_distribution<std::uint32_t> shift_dist(0, 63);
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; i += batch_size) {
+		const std::size_t count = std::min<std::uint64_t>(batch_size, result.end - i);
+		for (std::size_t j = 0; j < count; ++j) {
+			if constexpr (sizeof(Int) == 4) {
+				ints[j] = static_cast<Int>(i + j);
+			} else {
+				ints[j] = static_cast<Int>(value_dist(rng) >> shift_dist(rng));
+			}
 		}
+		test_batch(count);
 
-		if (i == std::numeric_limits<std::int32_t>::max()) {
-			break;
+		if ((i - result.begin) % (1ull << 28) == 0) {
+			std::cout << "int -> float: Tested " << i << "\n";
 		}
 	}
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	task.finish();
 
-	std::cout << "\n----------\n\n";
+	std::fesetround(FE_TONEAREST);
+	return result;
+}
+
+// Tests float to int conversion of all bit patterns against hardware rounding, including saturation and status flags
+template <float_utils::rounding_mode RoundingMode, typename Int> shard_result test_to_int(const shard_spec &spec) {
+	using status_type = float_utils::conversion_status::type;
+
+	shard_result result = create_result(
+		spec, "to_int_" + std::string(get_integer_type_name<Int>()), std::string(get_rounding_mode_name(RoundingMode)),
+		1ull << 32
+	);
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+	std::array<float, batch_size> floats;
+	std::array<Int, batch_size> my_ints;
+	std::array<status_type, batch_size> my_status;
+	std::fesetround(float_utils::to_fe_rounding_mode(RoundingMode));
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; i += batch_size) {
+		const std::size_t count = std::min<std::uint64_t>(batch_size, result.end - i);
+		for (std::size_t j = 0; j < count; ++j) {
+			floats[j] = std::bit_cast<float>(static_cast<std::uint32_t>(i + j));
+		}
+		float_utils::to_int_saturate_batch<Int, RoundingMode>(
+			std::span<const float>(floats.data(), count),
+			std::span<Int>(my_ints.data(), count),
+			std::span<status_type>(my_status.data(), count)
+		);
 
-	// float to int conversion
-	for (std::uint32_t i = 0; ; ++i) { // Test all bit patterns
-		const float fv = std::bit_cast<float>(i);
-		const std::optional<std::int32_t> my_i = float_utils::to_int(fv);
-		if (my_i) { // Avoid undefined behavior due to overflowing
-			const auto hw_i = static_cast<std::int32_t>(fv);
+		for (std::size_t j = 0; j < count; ++j) {
+			const float fv = floats[j];
 
-			if (std::bit_cast<std::uint32_t>(hw_i) != std::bit_cast<std::uint32_t>(my_i.value())) {
+			// Doubles can represent all rounded values and integer limits exactly
+			const double hw_rounded =
+				RoundingMode == float_utils::rounding_mode::nearest_tie_to_infinity ?
+				std::round(static_cast<double>(fv)) :
+				std::nearbyint(static_cast<double>(fv));
+			Int hw_i = 0;
+			status_type hw_status = float_utils::conversion_status::exact;
+			if (std::isnan(fv)) {
+				hw_status = float_utils::conversion_status::invalid;
+			} else if (hw_rounded < static_cast<double>(std::numeric_limits<Int>::min())) {
+				hw_i = std::numeric_limits<Int>::min();
+				hw_status = float_utils::conversion_status::overflow;
+			} else if (hw_rounded >= std::ldexp(static_cast<double>(std::numeric_limits<Int>::max() / 2 + 1), 1)) {
+				hw_i = std::numeric_limits<Int>::max();
+				hw_status = float_utils::conversion_status::overflow;
+			} else {
+				hw_i = static_cast<Int>(hw_rounded);
+				if (hw_rounded != static_cast<double>(fv)) {
+					hw_status = float_utils::conversion_status::inexact;
+				}
+			}
+
+			// The scalar version should agree with the batch version
+			const std::optional<Int> my_i = float_utils::to_int<Int, RoundingMode>(fv);
+			const bool expect_value = (my_status[j] & ~float_utils::conversion_status::inexact) == 0;
+			const bool scalar_matches = my_i.has_value() == expect_value && (!my_i || my_i.value() == my_ints[j]);
+
+			if (hw_i != my_ints[j] || hw_status != my_status[j]) {
 				std::cout <<
-					"Not equal: " << fv << "\n" <<
-					"Hardware conversion: " << hw_i << "\n" <<
-					"      My conversion: " << my_i.value() << "\n" <<
+					"Not equal: " << std::hexfloat << fv << std::defaultfloat << "\n" <<
+					"Hardware conversion: " << hw_i << "  status " << static_cast<int>(hw_status) << "\n" <<
+					"      My conversion: " << my_ints[j] << "  status " << static_cast<int>(my_status[j]) << "\n" <<
 					"----------\n";
 			}
+			if (!scalar_matches) {
+				std::cout << "Scalar and batch conversions differ: " << std::hexfloat << fv << std::defaultfloat << "\n";
+			}
+			if (hw_i != my_ints[j] || hw_status != my_status[j] || !scalar_matches) {
+				std::ostringstream failure;
+				failure <<
+					std::hex << std::bit_cast<std::uint32_t>(fv) << std::dec << " " <<
+					hw_i << " " << static_cast<int>(hw_status) << " " <<
+					my_ints[j] << " " << static_cast<int>(my_status[j]) << (scalar_matches ? "" : " scalar_differs");
+				result.add_failure(failure.str());
+				counters.add_mismatch();
+			}
 		}
+		counters.add_samples(count);
 
-		if (i % 100000000 == 0) {
+		if ((i - result.begin) % (1ull << 28) == 0) {
 			std::cout << "float -> int: Tested " << i << "\n";
 		}
+	}
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	task.finish();
+	std::fesetround(FE_TONEAREST);
+	return result;
+}
 
-		if (i == std::numeric_limits<std::uint32_t>::max()) {
-			break;
+template <float_utils::rounding_mode RoundingMode> void test_all_types(
+	const shard_spec &spec, std::vector<shard_result> &results
+) {
+	if (!spec.selects_mode(RoundingMode)) {
+		return;
+	}
+	std::cout << "Testing rounding mode " << get_rounding_mode_name(RoundingMode) << "\n";
+	auto run = [&](std::string_view name, auto &&test) {
+		if (!spec.selects_op(name)) {
+			return;
 		}
+		results.emplace_back(test(spec));
+		write_shard_results(spec.output, results);
+	};
+	// There is no hardware implementation of ties to infinity for int to float conversions
+	if constexpr (RoundingMode != float_utils::rounding_mode::nearest_tie_to_infinity) {
+		run("to_float_int32", test_to_float<RoundingMode, std::int32_t>);
+		run("to_float_uint32", test_to_float<RoundingMode, std::uint32_t>);
+		run("to_float_int64", test_to_float<RoundingMode, std::int64_t>);
+		run("to_float_uint64", test_to_float<RoundingMode, std::uint64_t>);
 	}
+	run("to_int_int32", test_to_int<RoundingMode, std::int32_t>);
+	run("to_int_uint32", test_to_int<RoundingMode, std::uint32_t>);
+	run("to_int_int64", test_to_int<RoundingMode, std::int64_t>);
+	run("to_int_uint64", test_to_int<RoundingMode, std::uint64_t>);
+	std::cout << "\n----------\n\n";
+}
+
+int main(int argc, char **argv) {
+	const std::optional<shard_spec> spec = parse_shard_spec(argc, argv);
+	if (!spec) {
+		return 1;
+	}
+	const telemetry_reporter reporter(spec.value());
 
+	std::vector<shard_result> results;
+	test_all_types<float_utils::rounding_mode::toward_zero>(spec.value(), results);
+	test_all_types<float_utils::rounding_mode::nearest_tie_to_even>(spec.value(), results);
+	test_all_types<float_utils::rounding_mode::nearest_tie_to_infinity>(spec.value(), results);
+	test_all_types<float_utils::rounding_mode::downward>(spec.value(), results);
+	test_all_types<float_utils::rounding_mode::upward>(spec.value(), results);
+
+	for (const shard_result &result : results) {
+		if (result.num_failed > 0) {
+			return 1;
+		}
+	}
 	return 0;
 }
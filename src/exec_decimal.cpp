@@ -0,0 +1,406 @@
+#include <array>
+#include <cerrno>
+#include <cfenv>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "float_utils/decimal.h"
+
+#include "shard.h"
+#include "telemetry.h"
+
+constexpr std::uint64_t default_iterations = 1ull << 22;
+constexpr std::size_t buffer_size = 64;
+
+// Formatting and parsing can be evaluated at compile time
+static_assert([]() {
+	std::array<char, float_utils::max_decimal_chars> buffer{};
+	const std::to_chars_result result = float_utils::to_chars(buffer.data(), buffer.data() + buffer.size(), 0.1f);
+	return std::string_view(buffer.data(), result.ptr) == "1e-01";
+}());
+static_assert([]() {
+	constexpr std::string_view str = "3.4028236e38";
+	float value = 0.0f;
+	float_utils::from_chars<float_utils::rounding_mode::toward_zero>(str.data(), str.data() + str.size(), value);
+	return value == std::numeric_limits<float>::max();
+}());
+// The tables written out in decimal.h match their generators
+static_assert(
+	float_utils::_details::ryu_pow5_split == float_utils::_details::generate_ryu_pow5_split() &&
+	float_utils::_details::ryu_pow5_inv_split == float_utils::_details::generate_ryu_pow5_inv_split() &&
+	float_utils::_details::powers_of_ten == float_utils::_details::generate_powers_of_ten()
+);
+
+// Checks that to_chars() produces the same string as std::to_chars() in scientific notation for the bit patterns
+// selected by the shard spec, which is the shortest representation that is closest to the float
+shard_result test_to_chars(const shard_spec &spec) {
+	shard_result result = create_result(spec, "to_chars", "none", 1ull << 32);
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; ++i) {
+		const float x = std::bit_cast<float>(static_cast<std::uint32_t>(i));
+		std::array<char, buffer_size> expected;
+		std::array<char, buffer_size> actual;
+		const std::to_chars_result expected_result =
+			std::to_chars(expected.data(), expected.data() + expected.size(), x, std::chars_format::scientific);
+		const std::to_chars_result actual_result = float_utils::to_chars(actual.data(), actual.data() + actual.size(), x);
+		const std::string_view expected_str(expected.data(), expected_result.ptr);
+		const std::string_view actual_str(actual.data(), actual_result.ptr);
+		if (expected_str != actual_str) {
+			std::ostringstream failure;
+			failure << std::hex << i << " " << expected_str << " " << actual_str;
+			record_failure(result, failure.str());
+			counters.add_mismatch();
+		}
+		counters.add_samples(1);
+	}
+	task.finish();
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout << "to_chars: " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Checks that from_chars() parses the shortest representations of the bit patterns selected by the shard spec back to
+// the same float, both in scientific and in fixed notation
+shard_result test_round_trip(const shard_spec &spec) {
+	shard_result result = create_result(spec, "round_trip", "nearest_tie_to_even", 1ull << 32);
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; ++i) {
+		const float x = std::bit_cast<float>(static_cast<std::uint32_t>(i));
+		for (const std::chars_format format : { std::chars_format::scientific, std::chars_format::fixed }) {
+			std::array<char, buffer_size> str;
+			const char *str_end = std::to_chars(str.data(), str.data() + str.size(), x, format).ptr;
+			float parsed = 0.0f;
+			const std::from_chars_result parse_result = float_utils::from_chars(str.data(), str_end, parsed);
+			if (!same_result(x, parsed) || parse_result.ptr != str_end || parse_result.ec != std::errc()) {
+				std::ostringstream failure;
+				failure <<
+					std::hex << i << " " << std::string_view(str.data(), str_end) << " " <<
+					std::bit_cast<std::uint32_t>(parsed) << " " << std::dec << (parse_result.ptr - str.data());
+				record_failure(result, failure.str());
+				counters.add_mismatch();
+			}
+		}
+		counters.add_samples(1);
+	}
+	task.finish();
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout << "round_trip: " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Generates decimal strings of all shapes: random digits with decimal points and exponents across the whole range,
+// exact midpoints between floats, exact floats, and long inputs that need the exact path
+class decimal_string_generator {
+public:
+	// Each shard should use a different random sequence, selected using the beginning of its range
+	decimal_string_generator(std::uint64_t seed, std::uint64_t begin) {
+		std::seed_seq seed_seq{
+			static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+			static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(begin >> 32)
+		};
+		_rng.seed(seed_seq);
+	}
+
+	[[nodiscard]] std::string operator()() {
+		std::string result = _rng() % 2 == 0 ? "-" : "";
+		switch (_rng() % 4) {
+		case 0:
+			result += random_digits();
+			break;
+		case 1:
+			{
+				// The midpoint between two floats is exact in double precision, and printing all of its digits gives a
+				// tie
+				const float x = std::abs(float_utils::random_float(_rng));
+				const float next = std::nextafter(x, std::numeric_limits<float>::infinity());
+				// Above the largest float, the midpoint is between it and 2^128
+				const double next_value = std::isinf(next) ? std::ldexp(1.0, 128) : static_cast<double>(next);
+				result += exact_decimal(0.5 * (static_cast<double>(x) + next_value));
+				break;
+			}
+		case 2:
+			// Exact floats, including the largest and smallest ones
+			result += exact_decimal(static_cast<double>(std::abs(float_utils::random_float(_rng))));
+			break;
+		default:
+			{
+				// Digits near the largest float, the midpoint between it and 2^128, half of the smallest subnormal, and
+				// the smallest subnormal
+				constexpr std::array<std::string_view, 4> prefixes{
+					"3.4028234e38", "3.4028235e38", "7.006492e-46", "1.4012984e-45"
+				};
+				const std::string_view prefix = prefixes[_rng() % prefixes.size()];
+				const std::size_t exponent_pos = prefix.find('e');
+				result += prefix.substr(0, exponent_pos);
+				result += random_digits_only(_rng() % 30);
+				result += prefix.substr(exponent_pos);
+				break;
+			}
+		}
+		return result;
+	}
+private:
+	std::default_random_engine _rng;
+
+	[[nodiscard]] std::string random_digits_only(std::size_t count) {
+		std::string result;
+		for (std::size_t i = 0; i < count; ++i) {
+			result += static_cast<char>('0' + _rng() % 10);
+		}
+		return result;
+	}
+	[[nodiscard]] std::string random_digits() {
+		// Mostly short inputs, sometimes with leading zeros or with more digits than the exact path keeps
+		const std::size_t length_class = _rng() % 8;
+		const std::size_t num_digits =
+			length_class < 5 ? 1 + _rng() % 12 : length_class < 7 ? 1 + _rng() % 40 : 100 + _rng() % 100;
+		std::string result = random_digits_only(num_digits);
+		if (_rng() % 2 == 0) {
+			result.insert(_rng() % (result.size() + 1), ".");
+		}
+		if (_rng() % 4 != 0) {
+			const std::int32_t exponent = static_cast<std::int32_t>(_rng() % 100) - 60;
+			result += (_rng() % 2 == 0 ? "e" : "E") + std::to_string(exponent);
+		}
+		return result;
+	}
+	// All digits of a double, which is exact
+	[[nodiscard]] static std::string exact_decimal(double value) {
+		std::array<char, 1024> buffer;
+		const std::to_chars_result result =
+			std::to_chars(buffer.data(), buffer.data() + buffer.size(), value, std::chars_format::scientific, 200);
+		std::string str(buffer.data(), result.ptr);
+		// Remove trailing zeros of the mantissa
+		const std::size_t exponent_pos = str.find('e');
+		std::size_t mantissa_end = exponent_pos;
+		for (; str[mantissa_end - 1] == '0'; --mantissa_end) {
+		}
+		return str.substr(0, mantissa_end) + str.substr(exponent_pos);
+	}
+};
+
+// Parses using strtof() and strtod() in the given rounding mode, which are correctly rounded by glibc
+template <typename Float> [[nodiscard]] Float reference_parse(const std::string &str, int fe_rounding, bool &range_error) {
+	const int old_rounding = std::fegetround();
+	std::fesetround(fe_rounding);
+	errno = 0;
+	Float result;
+	if constexpr (std::is_same_v<Float, float>) {
+		result = std::strtof(str.c_str(), nullptr);
+	} else {
+		result = std::strtod(str.c_str(), nullptr);
+	}
+	range_error = errno == ERANGE;
+	std::fesetround(old_rounding);
+	return result;
+}
+
+// Tests from_chars() on random decimal strings against the C library. Ties of nearest_tie_to_infinity, which the C
+// library does not support, are detected by parsing in double precision
+template <float_utils::rounding_mode RoundingMode> shard_result test_from_chars(const shard_spec &spec) {
+	using enum float_utils::rounding_mode;
+
+	const std::uint64_t iterations = spec.iterations.value_or(default_iterations);
+	shard_result result = create_result(spec, "from_chars", std::string(get_rounding_mode_name(RoundingMode)), iterations);
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+
+	decimal_string_generator generate(spec.seed, result.begin);
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; ++i) {
+		const std::string str = generate();
+
+		bool range_error = false;
+		float expected = 0.0f;
+		if constexpr (RoundingMode == nearest_tie_to_infinity) {
+			expected = reference_parse<float>(str, FE_TONEAREST, range_error);
+			bool unused = false;
+			const float down = reference_parse<float>(str, FE_DOWNWARD, unused);
+			const float up = reference_parse<float>(str, FE_UPWARD, unused);
+			const double exact = reference_parse<double>(str, FE_DOWNWARD, unused);
+			const bool is_tie =
+				exact == reference_parse<double>(str, FE_UPWARD, unused) &&
+				static_cast<double>(down) + static_cast<double>(up) == 2.0 * exact;
+			if (is_tie && down != up) {
+				expected = std::abs(down) > std::abs(up) ? down : up;
+			}
+		} else {
+			expected = reference_parse<float>(str, float_utils::to_fe_rounding_mode(RoundingMode), range_error);
+		}
+		const bool expected_out_of_range =
+			range_error &&
+			(expected == 0.0f || std::isinf(expected) || std::abs(expected) == std::numeric_limits<float>::max());
+
+		float actual = 0.0f;
+		const std::from_chars_result parse_result =
+			float_utils::from_chars<RoundingMode>(str.data(), str.data() + str.size(), actual);
+		const bool out_of_range = parse_result.ec == std::errc::result_out_of_range;
+		if (
+			!same_result(expected, actual) || parse_result.ptr != str.data() + str.size() ||
+			out_of_range != expected_out_of_range
+		) {
+			std::ostringstream failure;
+			failure <<
+				str << " " << std::hex << std::bit_cast<std::uint32_t>(expected) << " " <<
+				std::bit_cast<std::uint32_t>(actual) << " " << std::dec << expected_out_of_range << " " << out_of_range;
+			record_failure(result, failure.str());
+			counters.add_mismatch();
+		}
+		counters.add_samples(1);
+	}
+	task.finish();
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout << "from_chars (" << result.mode << "): " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Checks how much of malformed and special inputs is consumed, against std::from_chars()
+shard_result test_syntax(const shard_spec &spec) {
+	constexpr std::array<std::string_view, 26> inputs{
+		"", "-", ".", "-.", "e5", ".e5", "1e", "1e+", "1e-x", "1.5e+3x", "1..5", "00012.500", "-0", "-0.0e-999",
+		"+1", " 1", "inf", "-Infinity", "infinit", "INFx", "nan", "-NaN(abc_12)", "nan(", "nan(a-b)", "1e99999999999",
+		"0x1p3"
+	};
+	shard_result result = create_result(spec, "syntax", "none", inputs.size());
+	for (std::uint64_t i = result.begin; i < result.end; ++i) {
+		const std::string_view str = inputs[i];
+		float expected = 1.0f;
+		float actual = 1.0f;
+		const std::from_chars_result expected_result = std::from_chars(str.data(), str.data() + str.size(), expected);
+		const std::from_chars_result actual_result = float_utils::from_chars(str.data(), str.data() + str.size(), actual);
+		// std::from_chars() does not store values that are out of range
+		const bool values_match = expected_result.ec != std::errc() || same_result(expected, actual);
+		if (
+			expected_result.ptr != actual_result.ptr || expected_result.ec != actual_result.ec || !values_match ||
+			std::signbit(expected) != std::signbit(actual)
+		) {
+			std::ostringstream failure;
+			failure <<
+				"\"" << str << "\" " << (expected_result.ptr - str.data()) << " " << (actual_result.ptr - str.data()) <<
+				" " << static_cast<int>(expected_result.ec) << " " << static_cast<int>(actual_result.ec);
+			record_failure(result, failure.str());
+		}
+	}
+	std::cout << "syntax: " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Reports the time per value of formatting and parsing random floats
+void benchmark(std::uint64_t seed) {
+	constexpr std::size_t count = 1 << 20;
+
+	std::default_random_engine rng(static_cast<std::default_random_engine::result_type>(seed));
+	std::vector<float> values(count);
+	for (float &value : values) {
+		value = float_utils::random_float(rng);
+	}
+	std::vector<char> text(count * buffer_size);
+	std::vector<std::string_view> strings(count);
+
+	auto report = [&](std::string_view name, auto &&func) {
+		const auto start = std::chrono::steady_clock::now();
+		std::uint32_t checksum = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			checksum += func(i);
+		}
+		const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+		std::cout <<
+			name << 1e9 * duration.count() / static_cast<double>(count) << " ns/value (checksum " << checksum << ")\n";
+	};
+	auto format = [&](auto &&to_chars) {
+		return [&](std::size_t i) {
+			char *first = text.data() + i * buffer_size;
+			const char *last = to_chars(first, first + buffer_size, values[i]).ptr;
+			strings[i] = std::string_view(first, last);
+			return static_cast<std::uint32_t>(last - first);
+		};
+	};
+	auto parse = [&](auto &&from_chars) {
+		return [&](std::size_t i) {
+			float value = 0.0f;
+			from_chars(strings[i].data(), strings[i].data() + strings[i].size(), value);
+			return std::bit_cast<std::uint32_t>(value);
+		};
+	};
+
+	report("std::to_chars:             ", format([](char *first, char *last, float x) {
+		return std::to_chars(first, last, x, std::chars_format::scientific);
+	}));
+	report("float_utils::to_chars:     ", format([](char *first, char *last, float x) {
+		return float_utils::to_chars(first, last, x);
+	}));
+	report("std::from_chars:           ", parse([](const char *first, const char *last, float &x) {
+		return std::from_chars(first, last, x);
+	}));
+	report("float_utils::from_chars:   ", parse([](const char *first, const char *last, float &x) {
+		return float_utils::from_chars(first, last, x);
+	}));
+	report("  toward_zero:             ", parse([](const char *first, const char *last, float &x) {
+		return float_utils::from_chars<float_utils::rounding_mode::toward_zero>(first, last, x);
+	}));
+
+	// Nine significant digits are more than the shortest representation, and are not exactly on a float
+	report("std::to_chars, 9 digits:   ", format([](char *first, char *last, float x) {
+		return std::to_chars(first, last, x, std::chars_format::scientific, 8);
+	}));
+	report("std::from_chars:           ", parse([](const char *first, const char *last, float &x) {
+		return std::from_chars(first, last, x);
+	}));
+	report("float_utils::from_chars:   ", parse([](const char *first, const char *last, float &x) {
+		return float_utils::from_chars(first, last, x);
+	}));
+}
+
+int main(int argc, char **argv) {
+	using enum float_utils::rounding_mode;
+
+	const std::optional<shard_spec> spec = parse_shard_spec(argc, argv);
+	if (!spec) {
+		return 1;
+	}
+	const telemetry_reporter reporter(spec.value());
+
+	std::vector<shard_result> results;
+	auto run = [&](std::string_view name, std::optional<float_utils::rounding_mode> mode, auto &&test) {
+		if (spec->selects_op(name) && (!mode ? !spec->mode : spec->selects_mode(mode.value()))) {
+			results.emplace_back(test(spec.value()));
+			write_shard_results(spec->output, results);
+		}
+	};
+	run("syntax", std::nullopt, test_syntax);
+	run("from_chars", toward_zero, test_from_chars<toward_zero>);
+	run("from_chars", nearest_tie_to_even, test_from_chars<nearest_tie_to_even>);
+	run("from_chars", nearest_tie_to_infinity, test_from_chars<nearest_tie_to_infinity>);
+	run("from_chars", downward, test_from_chars<downward>);
+	run("from_chars", upward, test_from_chars<upward>);
+	run("to_chars", std::nullopt, test_to_chars);
+	run("round_trip", nearest_tie_to_even, test_round_trip);
+
+	if (spec->selects_op("benchmark") && !spec->mode) {
+		benchmark(spec->seed);
+	}
+
+	for (const shard_result &result : results) {
+		if (result.num_failed > 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
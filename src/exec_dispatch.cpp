@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "float_utils/conversions.h"
+#include "float_utils/dispatch.h"
+#include "float_utils/rounding.h"
+
+#include "shard.h"
+#include "telemetry.h"
+
+constexpr std::size_t batch_size = 4096;
+
+// Runs the batch function on the inputs selected by the shard spec using the given SIMD level, and checks that every
+// output is bitwise identical to that of the scalar function. MakeInput maps an index in [0, 2^32) and a random engine
+// to an input, and Check compares one output against the scalar function, returning a description of any mismatch
+template <typename In, typename Out, typename MakeInput, typename RunBatch, typename Check> shard_result test_kernel(
+	const shard_spec &spec, std::string_view name, std::string_view mode_name, float_utils::simd_level level,
+	MakeInput &&make_input, RunBatch &&run_batch, Check &&check
+) {
+	shard_result result = create_result(
+		spec, std::string(name) + "." + std::string(float_utils::get_simd_level_name(level)), std::string(mode_name),
+		1ull << 32
+	);
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+
+	std::seed_seq seed_seq{
+		static_cast<std::uint32_t>(spec.seed), static_cast<std::uint32_t>(spec.seed >> 32),
+		static_cast<std::uint32_t>(result.begin), static_cast<std::uint32_t>(result.begin >> 32)
+	};
+	std::default_random_engine rng(seed_seq);
+	std::array<In, batch_size> inputs;
+	std::array<Out, batch_size> outputs;
+	std::chrono::duration<double> batch_duration{ 0.0 };
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; i += batch_size) {
+		const std::size_t count = std::min<std::uint64_t>(batch_size, result.end - i);
+		for (std::size_t j = 0; j < count; ++j) {
+			inputs[j] = make_input(i + j, rng);
+		}
+		const auto batch_start = std::chrono::steady_clock::now();
+		run_batch(std::span<const In>(inputs.data(), count), std::span<Out>(outputs.data(), count));
+		batch_duration += std::chrono::steady_clock::now() - batch_start;
+
+		for (std::size_t j = 0; j < count; ++j) {
+			std::optional<std::string> mismatch = check(inputs[j], outputs[j], j);
+			if (!mismatch) {
+				continue;
+			}
+			record_failure(result, std::move(mismatch.value()));
+			counters.add_mismatch();
+		}
+		counters.add_samples(count);
+	}
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	task.finish();
+
+	std::cout <<
+		result.test << " (" << mode_name << "): " << result.num_failed << " mismatches, " <<
+		1e9 * batch_duration.count() / static_cast<double>(std::max<std::uint64_t>(result.num_tested, 1)) <<
+		" ns/element\n";
+	return result;
+}
+
+template <typename Int> [[nodiscard]] constexpr std::string_view get_integer_type_name() {
+	if constexpr (std::is_signed_v<Int>) {
+		return sizeof(Int) == 4 ? "int32" : "int64";
+	} else {
+		return sizeof(Int) == 4 ? "uint32" : "uint64";
+	}
+}
+
+[[nodiscard]] float bit_pattern(std::uint64_t index, std::default_random_engine&) {
+	return std::bit_cast<float>(static_cast<std::uint32_t>(index));
+}
+
+template <typename BatchFunc, typename BitsFunc> shard_result test_rounding(
+	const shard_spec &spec, std::string_view name, float_utils::simd_level level,
+	BatchFunc &&batch_func, BitsFunc &&bits_func
+) {
+	return test_kernel<float, float>(
+		spec, name, "none", level, bit_pattern, batch_func,
+		[&](float in, float out, std::size_t) -> std::optional<std::string> {
+			const std::uint32_t expected = bits_func(std::bit_cast<std::uint32_t>(in));
+			if (std::bit_cast<std::uint32_t>(out) == expected) {
+				return std::nullopt;
+			}
+			std::ostringstream failure;
+			failure << std::hex << std::bit_cast<std::uint32_t>(in) << " " << expected << " " << std::bit_cast<std::uint32_t>(out);
+			return failure.str();
+		}
+	);
+}
+
+template <float_utils::rounding_mode RoundingMode, typename Int> shard_result test_to_float(
+	const shard_spec &spec, float_utils::simd_level level
+) {
+	// 32-bit integers are tested exhaustively, and 64-bit integers using random values of all magnitudes
+	std::uniform_int_distribution<std::uint64_t> value_dist;
+	std::uniform_int_distribution<std::uint32_t> shift_dist(0, 63);
+	auto make_input = [&](std::uint64_t index, std::default_random_engine &rng) {
+		if constexpr (sizeof(Int) == 4) {
+			return static_cast<Int>(index);
+		} else {
+			return static_cast<Int>(value_dist(rng) >> shift_dist(rng));
+		}
+	};
+	return test_kernel<Int, float>(
+		spec, "to_float_" + std::string(get_integer_type_name<Int>()),
+		get_rounding_mode_name(RoundingMode), level, make_input,
+		[](std::span<const Int> in, std::span<float> out) {
+			float_utils::to_float_batch<RoundingMode>(in, out);
+		},
+		[](Int in, float out, std::size_t) -> std::optional<std::string> {
+			const float expected = float_utils::to_float<RoundingMode>(in);
+			if (std::bit_cast<std::uint32_t>(out) == std::bit_cast<std::uint32_t>(expected)) {
+				return std::nullopt;
+			}
+			std::ostringstream failure;
+			failure << in << " " << std::hex << std::bit_cast<std::uint32_t>(expected) << " " << std::bit_cast<std::uint32_t>(out);
+			return failure.str();
+		}
+	);
+}
+
+// The batch overloads with and without status are separate tests, so that each reports its own time per element
+template <float_utils::rounding_mode RoundingMode, typename Int, bool WithStatus> shard_result test_to_int(
+	const shard_spec &spec, float_utils::simd_level level
+) {
+	using status_type = float_utils::conversion_status::type;
+
+	std::array<status_type, batch_size> status;
+	return test_kernel<float, Int>(
+		spec, "to_int_" + std::string(get_integer_type_name<Int>()) + (WithStatus ? "_status" : ""),
+		get_rounding_mode_name(RoundingMode), level, bit_pattern,
+		[&](std::span<const float> in, std::span<Int> out) {
+			if constexpr (WithStatus) {
+				float_utils::to_int_saturate_batch<Int, RoundingMode>(
+					in, out, std::span<status_type>(status.data(), in.size())
+				);
+			} else {
+				float_utils::to_int_saturate_batch<Int, RoundingMode>(in, out);
+			}
+		},
+		[&](float in, Int out, std::size_t index) -> std::optional<std::string> {
+			status_type expected_status = float_utils::conversion_status::exact;
+			const Int expected = float_utils::to_int_saturate<Int, RoundingMode>(in, expected_status);
+			if (out == expected && (!WithStatus || status[index] == expected_status)) {
+				return std::nullopt;
+			}
+			std::ostringstream failure;
+			failure <<
+				std::hex << std::bit_cast<std::uint32_t>(in) << std::dec << " " <<
+				expected << " " << static_cast<int>(expected_status) << " " << out;
+			if constexpr (WithStatus) {
+				failure << " " << static_cast<int>(status[index]);
+			}
+			return failure.str();
+		}
+	);
+}
+
+template <float_utils::rounding_mode RoundingMode> shard_result test_to_bfloat16(
+	const shard_spec &spec, float_utils::simd_level level
+) {
+	return test_kernel<float, float_utils::bfloat16_bits>(
+		spec, "to_bfloat16", get_rounding_mode_name(RoundingMode), level, bit_pattern,
+		[](std::span<const float> in, std::span<float_utils::bfloat16_bits> out) {
+			float_utils::to_bfloat16_batch<RoundingMode>(in, out);
+		},
+		[](float in, float_utils::bfloat16_bits out, std::size_t) -> std::optional<std::string> {
+			const float_utils::bfloat16_bits expected = float_utils::to_bfloat16<RoundingMode>(in);
+			if (out == expected) {
+				return std::nullopt;
+			}
+			std::ostringstream failure;
+			failure << std::hex << std::bit_cast<std::uint32_t>(in) << " " << expected << " " << out;
+			return failure.str();
+		}
+	);
+}
+
+template <float_utils::rounding_mode RoundingMode> void test_conversions(
+	const shard_spec &spec, float_utils::simd_level level, std::vector<shard_result> &results
+) {
+	if (!spec.selects_mode(RoundingMode)) {
+		return;
+	}
+	auto run = [&](std::string_view name, auto &&test) {
+		if (spec.selects_op(name)) {
+			results.emplace_back(test(spec, level));
+			write_shard_results(spec.output, results);
+		}
+	};
+	run("to_float_int32", test_to_float<RoundingMode, std::int32_t>);
+	run("to_float_uint32", test_to_float<RoundingMode, std::uint32_t>);
+	run("to_float_int64", test_to_float<RoundingMode, std::int64_t>);
+	run("to_float_uint64", test_to_float<RoundingMode, std::uint64_t>);
+	run("to_int_int32", test_to_int<RoundingMode, std::int32_t, false>);
+	run("to_int_uint32", test_to_int<RoundingMode, std::uint32_t, false>);
+	run("to_int_int64", test_to_int<RoundingMode, std::int64_t, false>);
+	run("to_int_uint64", test_to_int<RoundingMode, std::uint64_t, false>);
+	run("to_int_int32_status", test_to_int<RoundingMode, std::int32_t, true>);
+	run("to_int_uint32_status", test_to_int<RoundingMode, std::uint32_t, true>);
+	run("to_int_int64_status", test_to_int<RoundingMode, std::int64_t, true>);
+	run("to_int_uint64_status", test_to_int<RoundingMode, std::uint64_t, true>);
+	run("to_bfloat16", test_to_bfloat16<RoundingMode>);
+}
+
+int main(int argc, char **argv) {
+	const std::optional<shard_spec> spec = parse_shard_spec(argc, argv);
+	if (!spec) {
+		return 1;
+	}
+	const telemetry_reporter reporter(spec.value());
+
+	const float_utils::simd_level supported = float_utils::get_supported_simd_level();
+	std::cout << "Supported SIMD level: " << float_utils::get_simd_level_name(supported) << "\n";
+
+	std::vector<shard_result> results;
+	for (std::size_t i = 0; i <= static_cast<std::size_t>(supported); ++i) {
+		const auto level = static_cast<float_utils::simd_level>(i);
+		float_utils::set_simd_level(level);
+		std::cout << "Testing SIMD level " << float_utils::get_simd_level_name(level) << "\n";
+
+		auto run_rounding = [&](std::string_view name, auto &&batch_func, auto &&bits_func) {
+			if (spec->selects_op(name) && !spec->mode) {
+				results.emplace_back(test_rounding(spec.value(), name, level, batch_func, bits_func));
+				write_shard_results(spec->output, results);
+			}
+		};
+		run_rounding("trunc", float_utils::trunc_batch, float_utils::_details::trunc_bits);
+		run_rounding("round", float_utils::round_batch, float_utils::_details::round_bits);
+		run_rounding("floor", float_utils::floor_batch, float_utils::_details::floor_bits);
+		run_rounding("ceil", float_utils::ceil_batch, float_utils::_details::ceil_bits);
+
+		test_conversions<float_utils::rounding_mode::toward_zero>(spec.value(), level, results);
+		test_conversions<float_utils::rounding_mode::nearest_tie_to_even>(spec.value(), level, results);
+		test_conversions<float_utils::rounding_mode::nearest_tie_to_infinity>(spec.value(), level, results);
+		test_conversions<float_utils::rounding_mode::downward>(spec.value(), level, results);
+		test_conversions<float_utils::rounding_mode::upward>(spec.value(), level, results);
+		std::cout << "----------\n";
+	}
+
+	for (const shard_result &result : results) {
+		if (result.num_failed > 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
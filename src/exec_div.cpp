@@ -1,17 +1,39 @@
 #include <iostream>
+#include <limits>
 
 #include "float_utils/div.h"
 
 #include "fuzz.h"
 
-constexpr auto rounding_mode = float_utils::rounding_mode::nearest_tie_to_even;
+// Compile-time edge cases
+namespace div_vectors {
+	using float_utils::div;
+	using enum float_utils::rounding_mode;
 
-int main() {
-	std::fesetround(float_utils::to_fe_rounding_mode(rounding_mode));
-	fuzz_binary_float_operator(
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(6.0f, 3.0f), 2.0f));
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(-1.0f, 4.0f), -0.25f));
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(1.0f, 3.0f), 0x1.555556p-2f));
+	static_assert(bitwise_equal(div<toward_zero>(1.0f, 3.0f), 0x1.555554p-2f));
+	static_assert(bitwise_equal(div<upward>(1.0f, 3.0f), 0x1.555556p-2f));
+	static_assert(bitwise_equal(div<downward>(1.0f, 3.0f), 0x1.555554p-2f));
+	static_assert(bitwise_equal(div<downward>(-1.0f, 3.0f), -0x1.555556p-2f));
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(2.0f, 3.0f), 0x1.555556p-1f));
+	// Zeros and subnormals
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(-0.0f, 3.0f), -0.0f));
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(1.0f, -0.0f), -std::numeric_limits<float>::infinity()));
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(0x1p-149f, 0x1p-149f), 1.0f));
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(0x1p-126f, 4.0f), 0x1p-128f));
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(0x1p-149f, 2.0f), 0.0f));
+	static_assert(bitwise_equal(div<upward>(0x1p-149f, 3.0f), 0x1p-149f));
+	static_assert(bitwise_equal(div<nearest_tie_to_even>(1.0f, 0x1p-149f), std::numeric_limits<float>::infinity()));
+}
+
+int main(int argc, char **argv) {
+	return fuzz_main(
+		argc, argv,
+		fuzz_operator::div,
 		[](float x, float y) { return x / y; },
-		float_utils::div<rounding_mode>,
+		[]<float_utils::rounding_mode Mode>() { return float_utils::div<Mode, float_utils::path_counters>; },
 		"div"
 	);
-	return 0;
 }
@@ -0,0 +1,201 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "float_utils/dispatch.h"
+#include "float_utils/gemm.h"
+
+#include "shard.h"
+#include "telemetry.h"
+
+// Matrices of one test, with c initialized to random values that the product is added to
+struct gemm_inputs {
+	std::size_t m = 0;
+	std::size_t n = 0;
+	std::size_t k = 0;
+	std::vector<float> a;
+	std::vector<float> b;
+	std::vector<float> c;
+};
+
+// With special values, some elements are replaced by zeros, subnormals, infinities, NaNs, and values that overflow or
+// underflow when multiplied, which the micro kernel leaves to the scalar add() and mul()
+[[nodiscard]] gemm_inputs generate_gemm_inputs(
+	std::size_t m, std::size_t n, std::size_t k, std::uint64_t seed, bool special_values = false
+) {
+	constexpr std::array specials{
+		0.0f, -0.0f, 0x1p-149f, -0x1.8p-130f, 0x1p-70f, -0x1p-80f, 0x1p70f, -0x1p80f, 0x1.fffffep127f,
+		std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+		std::numeric_limits<float>::quiet_NaN()
+	};
+	std::default_random_engine rng(static_cast<std::default_random_engine::result_type>(seed));
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	gemm_inputs result{ m, n, k, std::vector<float>(m * k), std::vector<float>(k * n), std::vector<float>(m * n) };
+	for (std::vector<float> *matrix : { &result.a, &result.b, &result.c }) {
+		for (float &v : *matrix) {
+			v = dist(rng);
+			// Special values are rare enough that most elements of c stay finite
+			if (special_values && rng() % 64 == 0) {
+				v = specials[rng() % specials.size()];
+			}
+		}
+	}
+	return result;
+}
+
+// The naive loop, which defines the expected results
+template <typename Mul, typename Add> void naive_gemm(gemm_inputs &inputs, Mul &&mul, Add &&add) {
+	for (std::size_t i = 0; i < inputs.m; ++i) {
+		for (std::size_t j = 0; j < inputs.n; ++j) {
+			float acc = inputs.c[i * inputs.n + j];
+			for (std::size_t p = 0; p < inputs.k; ++p) {
+				acc = add(acc, mul(inputs.a[i * inputs.k + p], inputs.b[p * inputs.n + j]));
+			}
+			inputs.c[i * inputs.n + j] = acc;
+		}
+	}
+}
+
+[[nodiscard]] bool same_bits(const std::vector<float> &lhs, const std::vector<float> &rhs) {
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](float x, float y) {
+		return std::bit_cast<std::uint32_t>(x) == std::bit_cast<std::uint32_t>(y);
+	});
+}
+
+struct gemm_case {
+	std::size_t m = 0;
+	std::size_t n = 0;
+	std::size_t k = 0;
+	bool special_values = false;
+};
+// Sizes that are not multiples of the tile and block sizes, and a depth spanning several slices
+constexpr std::array<gemm_case, 3> gemm_cases{ {
+	{ 67, 45, 129, false },
+	{ 130, 200, 600, false },
+	{ 67, 45, 129, true }
+} };
+
+// Checks that gemm() matches the naive loop bitwise for every SIMD level and number of threads, for the cases selected
+// by the shard spec
+template <float_utils::rounding_mode Mode> shard_result test_gemm(const shard_spec &spec) {
+	shard_result result = create_result(spec, "gemm", std::string(get_rounding_mode_name(Mode)), gemm_cases.size());
+
+	constexpr std::array<std::size_t, 4> thread_counts{ 1, 2, 3, 8 };
+	const std::size_t num_levels = static_cast<std::size_t>(float_utils::get_supported_simd_level()) + 1;
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; ++i) {
+		const auto [m, n, k, special_values] = gemm_cases[i];
+		const std::string name =
+			std::to_string(m) + "x" + std::to_string(n) + "x" + std::to_string(k) + (special_values ? "_special" : "");
+		gemm_inputs expected = generate_gemm_inputs(m, n, k, spec.seed, special_values);
+		const gemm_inputs inputs = expected;
+		naive_gemm(expected, float_utils::mul<Mode>, float_utils::add<Mode>);
+		bool passed = true;
+		for (std::size_t level = 0; level < num_levels; ++level) {
+			float_utils::set_simd_level(static_cast<float_utils::simd_level>(level));
+			for (const std::size_t num_threads : thread_counts) {
+				std::vector<float> c = inputs.c;
+				float_utils::gemm<Mode>(m, n, k, inputs.a, inputs.b, c, num_threads);
+				if (!same_bits(c, expected.c)) {
+					std::cout <<
+						"Mismatch in " << result.test << " (" << result.mode << "): " << name << ", " <<
+						float_utils::get_simd_level_name(static_cast<float_utils::simd_level>(level)) << ", " <<
+						num_threads << " threads\n";
+					passed = false;
+				}
+			}
+		}
+		if (!passed) {
+			result.add_failure(name);
+			counters.add_mismatch();
+		}
+		counters.add_samples(1);
+	}
+	task.finish();
+	float_utils::set_simd_level(float_utils::get_supported_simd_level());
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout << result.test << " (" << result.mode << "): " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Runs the function once and prints its throughput
+template <typename Func> void report_gflops(std::string_view name, const gemm_inputs &inputs, Func &&func) {
+	std::vector<float> c = inputs.c;
+	const auto start = std::chrono::steady_clock::now();
+	func(c);
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	const double flops = 2.0 * static_cast<double>(inputs.m) * static_cast<double>(inputs.n) * static_cast<double>(inputs.k);
+	std::cout << name << flops / duration.count() * 1e-9 << " GFLOP/s\n";
+}
+
+void benchmark_gemm(std::size_t size, std::uint64_t seed) {
+	using enum float_utils::rounding_mode;
+
+	const gemm_inputs inputs = generate_gemm_inputs(size, size, size, seed);
+	const std::size_t num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::cout << size << "x" << size << "x" << size << ":\n";
+	report_gflops("          Hardware naive: ", inputs, [&](std::vector<float> &c) {
+		gemm_inputs copy = inputs;
+		naive_gemm(copy, [](float x, float y) { return x * y; }, [](float x, float y) { return x + y; });
+		c = copy.c;
+	});
+	report_gflops("              Soft naive: ", inputs, [&](std::vector<float> &c) {
+		gemm_inputs copy = inputs;
+		naive_gemm(copy, float_utils::mul<nearest_tie_to_even>, float_utils::add<nearest_tie_to_even>);
+		c = copy.c;
+	});
+	report_gflops("     Soft gemm, 1 thread: ", inputs, [&](std::vector<float> &c) {
+		float_utils::gemm<nearest_tie_to_even>(size, size, size, inputs.a, inputs.b, c, 1);
+	});
+	if (num_threads > 1) {
+		report_gflops("    Soft gemm, " + std::to_string(num_threads) + " threads: ", inputs, [&](std::vector<float> &c) {
+			float_utils::gemm<nearest_tie_to_even>(size, size, size, inputs.a, inputs.b, c, num_threads);
+		});
+	}
+}
+
+int main(int argc, char **argv) {
+	using enum float_utils::rounding_mode;
+
+	const std::optional<shard_spec> spec = parse_shard_spec(argc, argv);
+	if (!spec) {
+		return 1;
+	}
+	const telemetry_reporter reporter(spec.value());
+
+	std::vector<shard_result> results;
+	auto run = [&](float_utils::rounding_mode mode, auto &&test) {
+		if (spec->selects_op("gemm") && spec->selects_mode(mode)) {
+			results.emplace_back(test(spec.value()));
+			write_shard_results(spec->output, results);
+		}
+	};
+	run(toward_zero, test_gemm<toward_zero>);
+	run(nearest_tie_to_even, test_gemm<nearest_tie_to_even>);
+	run(nearest_tie_to_infinity, test_gemm<nearest_tie_to_infinity>);
+	run(downward, test_gemm<downward>);
+	run(upward, test_gemm<upward>);
+
+	if (spec->selects_op("benchmark") && !spec->mode) {
+		for (const std::size_t size : { 64, 256, 512 }) {
+			benchmark_gemm(size, spec->seed);
+		}
+	}
+
+	for (const shard_result &result : results) {
+		if (result.num_failed > 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
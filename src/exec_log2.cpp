@@ -1,18 +1,46 @@
+#include <cmath>
 #include <iostream>
+#include <random>
+#include <string_view>
+#include <vector>
 
 #include "float_utils/log2.h"
 
-int main() {
-	for (float x; ; ) {
-		std::cout << "x = ";
-		std::cin >> x;
-		if (!std::cin) {
-			break;
-		}
+#include "bench.h"
 
+// The integer-only version can be evaluated at compile time, and produces exact results for powers of two
+static_assert(float_utils::log2_fixed(8.0f) == 3.0f);
+static_assert(float_utils::log2_fixed(0x1p-149f) == -149.0f);
+static_assert(float_utils::log2_fixed(1.0f) == 0.0f);
+
+// Reports the throughput and error of the hardware-float and integer-only versions side by side
+void compare() {
+	std::default_random_engine rng(12345);
+	std::vector<float> inputs(1 << 16);
+	for (float &x : inputs) {
+		x = std::abs(float_utils::random_normal_float(rng));
+	}
+	// Computed in double precision, which is correctly rounded for all but a few inputs close to ties
+	auto reference = [](float x) {
+		return static_cast<float>(std::log2(static_cast<double>(x)));
+	};
+	report_unary_float_function([](float x) { return std::log2f(x); }, reference, inputs, "   STL log: ");
+	report_unary_float_function(float_utils::log2<0>, reference, inputs, "   log2<0>: ");
+	report_unary_float_function(float_utils::log2<1>, reference, inputs, "   log2<1>: ");
+	report_unary_float_function(float_utils::log2_fixed, reference, inputs, "log2_fixed: ");
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && std::string_view(argv[1]) == "--compare") {
+		compare();
+		return 0;
+	}
+
+	while (const std::optional<float> x = read_float("x = ")) {
 		std::cout <<
-			"STL log: " << std::log2f(x) << "\n" <<
-			"Custom log: " << float_utils::log2(x) << "\n" <<
+			"STL log: " << float_utils::to_string(std::log2f(x.value())) << "\n" <<
+			"Custom log: " << float_utils::to_string(float_utils::log2(x.value())) << "\n" <<
+			"Fixed log: " << float_utils::to_string(float_utils::log2_fixed(x.value())) << "\n" <<
 			"\n";
 	}
 	return 0;
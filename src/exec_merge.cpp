@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "shard.h"
+
+constexpr std::size_t max_printed_failures = 16;
+
+// All shards of one test with one rounding mode
+struct merged_result {
+	std::vector<shard_result> shards;
+};
+
+// Prints the combined result of all shards of a test, and returns whether it passed and has been fully covered
+bool report(const std::string &test, const std::string &mode, merged_result &merged) {
+	std::uint64_t num_tested = 0;
+	std::uint64_t num_failed = 0;
+	double seconds = 0.0;
+	std::uint64_t total = merged.shards.front().total;
+	bool consistent_total = true;
+	for (const shard_result &shard : merged.shards) {
+		num_tested += shard.num_tested;
+		num_failed += shard.num_failed;
+		seconds += shard.seconds;
+		consistent_total = consistent_total && shard.total == total;
+	}
+
+	std::cout <<
+		test << " (" << mode << "): " << num_tested << " tested, " << num_failed << " failed, " <<
+		merged.shards.size() << " shards, " << seconds << "s in total\n";
+
+	// Check that the ranges of all shards cover the campaign exactly once
+	bool complete = true;
+	if (!consistent_total) {
+		std::cout << "  Shards disagree on the size of the campaign\n";
+		complete = false;
+	} else if (total > 0) {
+		std::sort(merged.shards.begin(), merged.shards.end(), [](const shard_result &lhs, const shard_result &rhs) {
+			return lhs.begin < rhs.begin;
+		});
+		std::uint64_t covered_end = 0;
+		for (const shard_result &shard : merged.shards) {
+			if (shard.begin > covered_end) {
+				std::cout << "  Missing [" << covered_end << ", " << shard.begin << ")\n";
+				complete = false;
+			} else if (shard.begin < covered_end) {
+				// Inputs in the overlap are counted more than once, so the number of tested inputs cannot be trusted
+				std::cout << "  Overlapping [" << shard.begin << ", " << std::min(covered_end, shard.end) << ")\n";
+				complete = false;
+			}
+			// Shards that have been interrupted have only tested part of their range
+			if (shard.num_tested < shard.end - shard.begin) {
+				std::cout <<
+					"  Incomplete shard [" << shard.begin << ", " << shard.end << "): " << shard.num_tested << " tested\n";
+				complete = false;
+			}
+			covered_end = std::max(covered_end, shard.end);
+		}
+		if (covered_end < total) {
+			std::cout << "  Missing [" << covered_end << ", " << total << ")\n";
+			complete = false;
+		}
+		if (complete) {
+			std::cout << "  Complete coverage of " << total << " inputs\n";
+		}
+	}
+
+	std::size_t num_printed = 0;
+	for (const shard_result &shard : merged.shards) {
+		for (const std::string &failure : shard.failures) {
+			if (num_printed++ < max_printed_failures) {
+				std::cout << "  Failure: " << failure << "\n";
+			}
+		}
+	}
+	if (num_printed > max_printed_failures) {
+		std::cout << "  " << num_printed - max_printed_failures << " more recorded failures\n";
+	}
+	return complete && num_failed == 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " RESULT_FILE...\n";
+		return 1;
+	}
+
+	std::map<std::pair<std::string, std::string>, merged_result> tests;
+	for (int i = 1; i < argc; ++i) {
+		std::optional<std::vector<shard_result>> results = read_shard_results(argv[i]);
+		if (!results) {
+			std::cerr << "Failed to read results from " << argv[i] << "\n";
+			return 1;
+		}
+		for (shard_result &result : results.value()) {
+			merged_result &merged = tests[{ result.test, result.mode }];
+			merged.shards.emplace_back(std::move(result));
+		}
+	}
+
+	bool all_passed = true;
+	for (auto &[key, merged] : tests) {
+		all_passed = report(key.first, key.second, merged) && all_passed;
+	}
+	std::cout << (all_passed ? "All tests passed with complete coverage\n" : "Some tests failed or are incomplete\n");
+	return all_passed ? 0 : 1;
+}
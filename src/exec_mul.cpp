@@ -1,17 +1,50 @@
 #include <iostream>
+#include <limits>
 
 #include "float_utils/mul.h"
 
 #include "fuzz.h"
 
-constexpr auto rounding_mode = float_utils::rounding_mode::nearest_tie_to_even;
+// Compile-time edge cases
+namespace mul_vectors {
+	using float_utils::mul;
+	using enum float_utils::rounding_mode;
 
-int main() {
-	std::fesetround(float_utils::to_fe_rounding_mode(rounding_mode));
-	fuzz_binary_float_operator(
+	constexpr float max = std::numeric_limits<float>::max();
+	constexpr float inf = std::numeric_limits<float>::infinity();
+
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(1.5f, 1.5f), 2.25f));
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(-2.0f, 3.0f), -6.0f));
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(-0.5f, -0.5f), 0.25f));
+	// (1 + 2^-23)^2 = 1 + 2^-22 + 2^-46
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(0x1.000002p0f, 0x1.000002p0f), 0x1.000004p0f));
+	static_assert(bitwise_equal(mul<toward_zero>(0x1.000002p0f, 0x1.000002p0f), 0x1.000004p0f));
+	static_assert(bitwise_equal(mul<upward>(0x1.000002p0f, 0x1.000002p0f), 0x1.000006p0f));
+	static_assert(bitwise_equal(mul<downward>(-0x1.000002p0f, 0x1.000002p0f), -0x1.000006p0f));
+	// Ties: (1 + 2^-12)^2 = 1 + 2^-11 + 2^-24, and (1 + 3 * 2^-12)^2 = 1 + 3 * 2^-11 + 9 * 2^-24
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(0x1.001p0f, 0x1.001p0f), 0x1.002p0f));
+	static_assert(bitwise_equal(mul<nearest_tie_to_infinity>(0x1.001p0f, 0x1.001p0f), 0x1.002002p0f));
+	// Overflow
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(max, 2.0f), inf));
+	static_assert(bitwise_equal(mul<toward_zero>(max, 2.0f), max));
+	static_assert(bitwise_equal(mul<downward>(max, -2.0f), -inf));
+	static_assert(bitwise_equal(mul<upward>(max, -2.0f), -max));
+	// Zeros and subnormals
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(-0.0f, 3.0f), -0.0f));
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(0x1p-149f, 0x1p100f), 0x1p-49f));
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(0x1p-100f, 0x1p-30f), 0x1p-130f));
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(0x1.8p-75f, 0x1p-75f), 0x1p-149f));
+	static_assert(bitwise_equal(mul<nearest_tie_to_even>(0x1p-75f, 0x1p-75f), 0.0f));
+	static_assert(bitwise_equal(mul<upward>(0x1p-75f, 0x1p-75f), 0x1p-149f));
+	static_assert(bitwise_equal(mul<downward>(-0x1p-100f, 0x1p-100f), -0x1p-149f));
+}
+
+int main(int argc, char **argv) {
+	return fuzz_main(
+		argc, argv,
+		fuzz_operator::mul,
 		[](float x, float y) { return x * y; },
-		float_utils::mul<rounding_mode>,
+		[]<float_utils::rounding_mode Mode>() { return float_utils::mul<Mode, float_utils::path_counters>; },
 		"mul"
 	);
-	return 0;
 }
@@ -1,7 +1,18 @@
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <vector>
 
 #include "float_utils/rcp.h"
 
+#include "bench.h"
+
+// The integer-only version can be evaluated at compile time
+static_assert(float_utils::rcp_fixed(4.0f) == 0.25f);
+static_assert(float_utils::rcp_fixed(-0.0f) == -std::numeric_limits<float>::infinity());
+
 template <std::uint32_t NewtonIterations = 1> float rcp_custom(float x, std::uint32_t c) {
 	const bool xp = float_parts::get_sign(x);
 	const std::int32_t xe = float_parts::get_offset_exponent(x);
@@ -77,7 +88,32 @@ template <std::uint32_t NewtonIterations> void test() {
 	std::cout << "Max error: " << max_error * 100.0f << "% at " << max_error_val <<"\n";
 }
 
-int main() {
+// Reports the throughput and error of the hardware-float and integer-only versions side by side
+void compare() {
+	std::default_random_engine rng(12345);
+	std::vector<float> inputs(1 << 16);
+	for (float &x : inputs) {
+		x = std::abs(float_utils::random_normal_float(rng));
+	}
+	auto reference = [](float x) {
+		return 1.0f / x;
+	};
+	report_unary_float_function(reference, reference, inputs, "        Hardware: ");
+	report_unary_float_function(float_utils::rcp<0>, reference, inputs, "          rcp<0>: ");
+	report_unary_float_function(float_utils::rcp<1>, reference, inputs, "          rcp<1>: ");
+	report_unary_float_function(float_utils::rcp<2>, reference, inputs, "          rcp<2>: ");
+	report_unary_float_function(float_utils::rcp_fixed<0>, reference, inputs, "    rcp_fixed<0>: ");
+	report_unary_float_function(float_utils::rcp_fixed<1>, reference, inputs, "    rcp_fixed<1>: ");
+	report_unary_float_function(float_utils::rcp_fixed<2>, reference, inputs, "    rcp_fixed<2>: ");
+	report_unary_float_function(float_utils::rcp_fixed<3>, reference, inputs, "    rcp_fixed<3>: ");
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && std::string_view(argv[1]) == "--compare") {
+		compare();
+		return 0;
+	}
+
 	/*
 	search_for_constant<0>();
 	search_for_constant<1>();
@@ -87,13 +123,11 @@ int main() {
 	test<2>();
 	*/
 
-	while (true) {
-		float x;
-		std::cout << "x = ";
-		std::cin >> x;
+	while (const std::optional<float> x = read_float("x = ")) {
 		std::cout <<
-			"Hardware reciprocal: " << 1.0f / x << "\n" <<
-			"      My reciprocal: " << float_utils::rcp<2>(x) << "\n";
+			"Hardware reciprocal: " << float_utils::to_string(1.0f / x.value()) << "\n" <<
+			"      My reciprocal: " << float_utils::to_string(float_utils::rcp<2>(x.value())) << "\n" <<
+			"   Fixed reciprocal: " << float_utils::to_string(float_utils::rcp_fixed(x.value())) << "\n";
 	}
 
 	return 0;
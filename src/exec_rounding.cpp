@@ -1,51 +1,130 @@
-#include <functional>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "float_utils/rounding.h"
 
-void test_func(std::function<float(float)> sys_version, std::function<float(float)> my_version) {
-	for (std::uint32_t i = 0; ; ++i) {
-		const float x = std::bit_cast<float>(i);
+#include "shard.h"
+#include "telemetry.h"
 
-		const float sys_v = sys_version(x);
-		const float my_v = my_version(x);
+constexpr std::size_t batch_size = 1 << 14;
+constexpr std::uint32_t max_reported_mismatches = 16;
 
-		const bool bin_eq = std::bit_cast<std::uint32_t>(sys_v) == std::bit_cast<std::uint32_t>(my_v);
-		const bool nan_eq = std::isnan(sys_v) == std::isnan(my_v);
+// Tests the bit patterns selected by the shard spec in vector batches, comparing the batch version against both the
+// scalar version and the system version. The range is split between all hardware threads
+template <typename BatchFunc, typename ScalarFunc, typename SysFunc> shard_result test_func(
+	const shard_spec &spec, std::string_view name,
+	BatchFunc &&batch_version, ScalarFunc &&scalar_version, SysFunc &&sys_version
+) {
+	shard_result result = create_result(spec, std::string(name), "none", 1ull << 32);
 
-		if (!nan_eq || (!std::isnan(sys_v) && !bin_eq)) {
-			std::cout <<
-				"Mismatch at " << x << ":\n" <<
-				"System version: " << sys_v << "  " << std::bit_cast<std::uint32_t>(sys_v) << "\n"
-				"    My version: " << my_v << "  " << std::bit_cast<std::uint32_t>(my_v) << "\n";
-		}
+	std::cout << "Testing " << name << "() on [" << result.begin << ", " << result.end << ")\n";
+	const auto start = std::chrono::steady_clock::now();
 
-		if (i % 1000000000 == 0) {
-			std::cout << "Tested " << i << "\n";
-		}
+	telemetry_task &task = telemetry::begin_task(result);
+	std::atomic<std::uint64_t> next_batch = result.begin;
+	std::mutex output_mutex;
+	auto worker = [&]() {
+		telemetry_counters &counters = task.add_thread();
+		std::array<float, batch_size> inputs;
+		std::array<float, batch_size> batch_results;
+		std::array<float, batch_size> sys_results;
+		while (true) {
+			const std::uint64_t batch_start = next_batch.fetch_add(batch_size, std::memory_order_relaxed);
+			if (batch_start >= result.end) {
+				break;
+			}
+			const std::size_t count = std::min<std::uint64_t>(batch_size, result.end - batch_start);
+
+			for (std::size_t i = 0; i < count; ++i) {
+				inputs[i] = std::bit_cast<float>(static_cast<std::uint32_t>(batch_start + i));
+			}
+			batch_version(
+				std::span<const float>(inputs.data(), count), std::span<float>(batch_results.data(), count)
+			);
+			for (std::size_t i = 0; i < count; ++i) {
+				sys_results[i] = sys_version(inputs[i]);
+			}
 
-		if (i == std::numeric_limits<std::uint32_t>::max()) {
-			break;
+			for (std::size_t i = 0; i < count; ++i) {
+				const float scalar_result = scalar_version(inputs[i]);
+				if (same_result(batch_results[i], sys_results[i]) && same_result(batch_results[i], scalar_result)) {
+					continue;
+				}
+				counters.add_mismatch();
+				std::lock_guard<std::mutex> lock(output_mutex);
+				std::ostringstream failure;
+				failure << std::hex <<
+					std::bit_cast<std::uint32_t>(inputs[i]) << " " << std::bit_cast<std::uint32_t>(sys_results[i]) << " " <<
+					std::bit_cast<std::uint32_t>(scalar_result) << " " << std::bit_cast<std::uint32_t>(batch_results[i]);
+				result.add_failure(failure.str());
+				if (result.num_failed <= max_reported_mismatches) {
+					std::cout <<
+						"Mismatch at " << inputs[i] << "  " << std::bit_cast<std::uint32_t>(inputs[i]) << ":\n" <<
+						"System version: " << sys_results[i] << "  " << std::bit_cast<std::uint32_t>(sys_results[i]) << "\n" <<
+						"Scalar version: " << scalar_result << "  " << std::bit_cast<std::uint32_t>(scalar_result) << "\n" <<
+						" Batch version: " << batch_results[i] << "  " << std::bit_cast<std::uint32_t>(batch_results[i]) << "\n";
+				}
+			}
+			counters.add_samples(count);
 		}
+	};
+
+	std::vector<std::thread> threads;
+	const std::uint32_t num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (std::uint32_t i = 0; i < num_threads; ++i) {
+		threads.emplace_back(worker);
 	}
-}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+	task.finish();
 
-int main() {
-	std::cout << "Testing trunc()\n";
-	test_func(std::truncf, float_utils::trunc);
-	std::cout << "----------\n";
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout <<
+		"Mismatches: " << result.num_failed << "\n" <<
+		"Time: " << duration.count() << "s using " << num_threads << " threads\n";
+	return result;
+}
 
-	std::cout << "Testing round()\n";
-	test_func(std::roundf, float_utils::round);
-	std::cout << "----------\n";
+int main(int argc, char **argv) {
+	const std::optional<shard_spec> spec = parse_shard_spec(argc, argv);
+	if (!spec) {
+		return 1;
+	}
+	const telemetry_reporter reporter(spec.value());
 
-	std::cout << "Testing floor()\n";
-	test_func(std::floorf, float_utils::floor);
-	std::cout << "----------\n";
+	std::vector<shard_result> results;
+	auto run = [&](std::string_view name, auto &&batch_version, auto &&scalar_version, auto &&sys_version) {
+		if (!spec->selects_op(name)) {
+			return;
+		}
+		results.emplace_back(test_func(spec.value(), name, batch_version, scalar_version, sys_version));
+		write_shard_results(spec->output, results);
+		std::cout << "----------\n";
+	};
 
-	std::cout << "Testing ceil()\n";
-	test_func(std::ceilf, float_utils::ceil);
-	std::cout << "----------\n";
+	run("trunc", float_utils::trunc_batch, float_utils::trunc, [](float x) { return std::trunc(x); });
+	run("round", float_utils::round_batch, float_utils::round, [](float x) { return std::round(x); });
+	run("floor", float_utils::floor_batch, float_utils::floor, [](float x) { return std::floor(x); });
+	run("ceil", float_utils::ceil_batch, float_utils::ceil, [](float x) { return std::ceil(x); });
 
+	for (const shard_result &result : results) {
+		if (result.num_failed > 0) {
+			return 1;
+		}
+	}
 	return 0;
 }
@@ -0,0 +1,498 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "float_utils/add.h"
+#include "float_utils/conversions.h"
+#include "float_utils/mul.h"
+
+#include "fuzz_inputs.h"
+#include "shard.h"
+#include "telemetry.h"
+
+constexpr std::size_t batch_size = 4096;
+constexpr std::uint64_t default_iterations = 1ull << 24;
+
+std::ostream &operator<<(std::ostream &out, std::pair<float, float> operands) {
+	return out << operands.first << " " << operands.second;
+}
+
+// Rounds a float to bfloat16 using double arithmetic, independently of the rounding logic of the library
+template <float_utils::rounding_mode RoundingMode> [[nodiscard]] float_utils::bfloat16_bits reference_to_bfloat16(
+	float f
+) {
+	using enum float_utils::rounding_mode;
+
+	const std::uint32_t bits = std::bit_cast<std::uint32_t>(f);
+	if (std::isnan(f)) {
+		return static_cast<float_utils::bfloat16_bits>((bits >> 16) | 0x40u);
+	}
+	const bool negative = std::signbit(f);
+	const std::uint32_t lower = (bits & ~float_parts::sign_mask) >> 16;
+	const double lower_value =
+		static_cast<double>(float_utils::from_bfloat16(static_cast<float_utils::bfloat16_bits>(lower)));
+	// The distance between the next bfloat16 and the lower one, which is also correct for the largest finite value
+	const double ulp = std::ldexp(1.0, std::max<std::int32_t>(static_cast<std::int32_t>(lower >> 7), 1) - 127 - 7);
+	const double distance = std::isinf(f) ? 0.0 : std::abs(static_cast<double>(f)) - lower_value;
+
+	bool round_up = false;
+	switch (RoundingMode) {
+	case downward:
+		round_up = negative && distance > 0.0;
+		break;
+	case upward:
+		round_up = !negative && distance > 0.0;
+		break;
+	case nearest_tie_to_even:
+		round_up = distance > 0.5 * ulp || (distance == 0.5 * ulp && (lower & 1u) != 0);
+		break;
+	case nearest_tie_to_infinity:
+		round_up = distance >= 0.5 * ulp;
+		break;
+	default:
+		break;
+	}
+	return static_cast<float_utils::bfloat16_bits>((negative ? 0x8000u : 0u) | (lower + (round_up ? 1u : 0u)));
+}
+
+// Tests conversion of the bit patterns selected by the shard spec to bfloat16 against the reference, using both the
+// batch and the scalar version
+template <float_utils::rounding_mode RoundingMode> shard_result test_to_bfloat16(const shard_spec &spec) {
+	shard_result result = create_result(
+		spec, "to_bfloat16", std::string(get_rounding_mode_name(RoundingMode)), 1ull << 32
+	);
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+	std::array<float, batch_size> inputs;
+	std::array<float_utils::bfloat16_bits, batch_size> outputs;
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; i += batch_size) {
+		const std::size_t count = std::min<std::uint64_t>(batch_size, result.end - i);
+		const std::uint64_t num_failed = result.num_failed;
+		for (std::size_t j = 0; j < count; ++j) {
+			inputs[j] = std::bit_cast<float>(static_cast<std::uint32_t>(i + j));
+		}
+		float_utils::to_bfloat16_batch<RoundingMode>(
+			std::span<const float>(inputs.data(), count), std::span<float_utils::bfloat16_bits>(outputs.data(), count)
+		);
+		for (std::size_t j = 0; j < count; ++j) {
+			const float_utils::bfloat16_bits expected = reference_to_bfloat16<RoundingMode>(inputs[j]);
+			const float_utils::bfloat16_bits scalar = float_utils::to_bfloat16<RoundingMode>(inputs[j]);
+			if (outputs[j] != expected || scalar != expected) {
+				std::ostringstream failure;
+				failure <<
+					std::hex << std::bit_cast<std::uint32_t>(inputs[j]) << " " << expected << " " << scalar << " " << outputs[j];
+				record_failure(result, failure.str());
+			}
+		}
+		counters.add_samples(count);
+		counters.add_mismatches(result.num_failed - num_failed);
+	}
+	task.finish();
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout << "to_bfloat16 (" << result.mode << "): " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Checks that stochastic rounding always produces one of the two neighbours of the exact result, i.e. the result of
+// rounding downward or upward, and that a batch reproduces the same sequence of scalar results after reseeding. Batch
+// takes the seed and the inputs, and returns the results as floats
+template <typename Input, typename Batch, typename Scalar, typename Downward, typename Upward> void check_stochastic(
+	shard_result &result, std::uint64_t seed, std::span<const Input> inputs,
+	Batch &&batch, Scalar &&scalar, Downward &&downward, Upward &&upward
+) {
+	const std::vector<float> batch_results = batch(seed, inputs);
+	float_utils::seed_stochastic_rounding(seed);
+	for (std::size_t i = 0; i < inputs.size(); ++i) {
+		const float scalar_result = scalar(inputs[i]);
+		const float lower = downward(inputs[i]);
+		const float upper = upward(inputs[i]);
+		const bool is_neighbour = same_result(scalar_result, lower) || same_result(scalar_result, upper);
+		if (!is_neighbour || !same_result(scalar_result, batch_results[i])) {
+			std::ostringstream failure;
+			failure <<
+				std::hexfloat << inputs[i] << " " << lower << " " << upper << " " <<
+				scalar_result << " " << batch_results[i];
+			record_failure(result, failure.str());
+		}
+	}
+}
+
+// Tests stochastic conversion of the bit patterns selected by the shard spec to bfloat16
+shard_result test_to_bfloat16_stochastic(const shard_spec &spec) {
+	using enum float_utils::rounding_mode;
+
+	shard_result result = create_result(spec, "to_bfloat16", "stochastic", 1ull << 32);
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+	std::array<float, batch_size> inputs;
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; i += batch_size) {
+		const std::size_t count = std::min<std::uint64_t>(batch_size, result.end - i);
+		const std::uint64_t num_failed = result.num_failed;
+		for (std::size_t j = 0; j < count; ++j) {
+			inputs[j] = std::bit_cast<float>(static_cast<std::uint32_t>(i + j));
+		}
+		check_stochastic(
+			result, spec.seed + i, std::span<const float>(inputs.data(), count),
+			[](std::uint64_t seed, std::span<const float> in) {
+				std::vector<float_utils::bfloat16_bits> out(in.size());
+				float_utils::seed_stochastic_rounding(seed);
+				float_utils::to_bfloat16_batch<stochastic>(in, out);
+				std::vector<float> values(in.size());
+				std::transform(out.begin(), out.end(), values.begin(), float_utils::from_bfloat16);
+				return values;
+			},
+			[](float x) { return float_utils::from_bfloat16(float_utils::to_bfloat16<stochastic>(x)); },
+			[](float x) { return float_utils::from_bfloat16(float_utils::to_bfloat16<downward>(x)); },
+			[](float x) { return float_utils::from_bfloat16(float_utils::to_bfloat16<upward>(x)); }
+		);
+		counters.add_samples(count);
+		counters.add_mismatches(result.num_failed - num_failed);
+	}
+	task.finish();
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout << "to_bfloat16 (stochastic): " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Tests stochastic rounding of a binary operator using fuzz inputs of all classes
+template <typename Scalar, typename Downward, typename Upward, typename Batch> shard_result test_binary_stochastic(
+	const shard_spec &spec, fuzz_operator op, std::string name,
+	Scalar &&scalar, Downward &&downward, Upward &&upward, Batch &&batch
+) {
+	using input = std::pair<float, float>;
+
+	const std::uint64_t iterations = spec.iterations.value_or(default_iterations);
+	shard_result result = create_result(spec, std::move(name), "stochastic", iterations);
+
+	// Each shard uses a different random sequence so that shards test different inputs
+	std::seed_seq seed_seq{
+		static_cast<std::uint32_t>(spec.seed), static_cast<std::uint32_t>(spec.seed >> 32),
+		static_cast<std::uint32_t>(result.begin), static_cast<std::uint32_t>(result.begin >> 32)
+	};
+	std::default_random_engine rng(seed_seq);
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
+	std::array<input, batch_size> inputs;
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = result.begin; i < result.end; i += batch_size) {
+		const std::size_t count = std::min<std::uint64_t>(batch_size, result.end - i);
+		const std::uint64_t num_failed = result.num_failed;
+		for (std::size_t j = 0; j < count; ++j) {
+			inputs[j] = generate_fuzz_inputs(rng, op, static_cast<input_class>((i + j) % num_input_classes));
+		}
+		check_stochastic(
+			result, spec.seed + i, std::span<const input>(inputs.data(), count),
+			[&](std::uint64_t seed, std::span<const input> in) {
+				std::vector<float> x(in.size());
+				std::vector<float> y(in.size());
+				std::vector<float> out(in.size());
+				for (std::size_t k = 0; k < in.size(); ++k) {
+					std::tie(x[k], y[k]) = in[k];
+				}
+				float_utils::seed_stochastic_rounding(seed);
+				batch(x, y, out);
+				return out;
+			},
+			[&](input in) { return scalar(in.first, in.second); },
+			[&](input in) { return downward(in.first, in.second); },
+			[&](input in) { return upward(in.first, in.second); }
+		);
+		counters.add_samples(count);
+		counters.add_mismatches(result.num_failed - num_failed);
+	}
+	task.finish();
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout << result.test << " (stochastic): " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Checks that stochastic rounding is unbiased: for each random input, the result is rounded up with probability equal
+// to the position of the exact result between its two neighbours. Exact is computed in double precision, and the
+// inputs are generated so that it is exact
+template <typename Generate, typename Exact, typename Scalar, typename Downward, typename Upward> void check_unbiased(
+	shard_result &result, std::default_random_engine &rng, std::uint64_t num_inputs, std::uint32_t num_draws,
+	Generate &&generate, Exact &&exact, Scalar &&scalar, Downward &&downward, Upward &&upward
+) {
+	for (std::uint64_t i = 0; i < num_inputs; ++i) {
+		const auto [x, y] = generate(rng);
+		const double lower = downward(x, y);
+		const double upper = upward(x, y);
+		if (lower == upper || !std::isfinite(upper) || !std::isfinite(lower)) {
+			continue;
+		}
+		const double probability = (exact(x, y) - lower) / (upper - lower);
+		std::uint32_t num_up = 0;
+		for (std::uint32_t j = 0; j < num_draws; ++j) {
+			num_up += static_cast<double>(scalar(x, y)) == upper ? 1 : 0;
+		}
+		// Allow six standard deviations of the binomial distribution
+		const double mean = probability * num_draws;
+		const double tolerance = 6.0 * std::sqrt(mean * (1.0 - probability)) + 1.0;
+		if (std::abs(static_cast<double>(num_up) - mean) > tolerance) {
+			std::ostringstream failure;
+			failure <<
+				std::hexfloat << x << " " << y << std::defaultfloat << " " <<
+				probability << " " << num_up << "/" << num_draws;
+			record_failure(result, failure.str());
+		}
+	}
+}
+
+shard_result test_unbiased(const shard_spec &spec) {
+	using enum float_utils::rounding_mode;
+	constexpr std::uint32_t num_inputs = 256;
+	constexpr std::uint32_t num_draws = 1 << 14;
+
+	// Each input is checked with add, mul, and conversion to bfloat16, and the inputs are split between shards
+	shard_result result = create_result(spec, "unbiased", "stochastic", num_inputs);
+	const std::uint64_t shard_inputs = result.end - result.begin;
+	float_utils::seed_stochastic_rounding(spec.seed + result.begin);
+	std::seed_seq seed_seq{
+		static_cast<std::uint32_t>(spec.seed), static_cast<std::uint32_t>(spec.seed >> 32),
+		static_cast<std::uint32_t>(result.begin), static_cast<std::uint32_t>(result.begin >> 32)
+	};
+	std::default_random_engine rng(seed_seq);
+	std::uniform_real_distribution<float> unit_dist(1.0f, 2.0f);
+	std::uniform_int_distribution<std::int32_t> shift_dist(-20, 20);
+	// The exponents of the operands of add differ by at most 20, so the sum is exact in double precision
+	auto generate = [&](std::default_random_engine &r) {
+		return std::pair(unit_dist(r) * (r() % 2 ? 1.0f : -1.0f), std::ldexp(unit_dist(r), shift_dist(r)));
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	check_unbiased(
+		result, rng, shard_inputs, num_draws, generate,
+		[](float x, float y) { return static_cast<double>(x) + static_cast<double>(y); },
+		float_utils::add<stochastic>, float_utils::add<downward>, float_utils::add<upward>
+	);
+	check_unbiased(
+		result, rng, shard_inputs, num_draws, generate,
+		[](float x, float y) { return static_cast<double>(x) * static_cast<double>(y); },
+		float_utils::mul<stochastic>, float_utils::mul<downward>, float_utils::mul<upward>
+	);
+	check_unbiased(
+		result, rng, shard_inputs, num_draws, generate,
+		[](float x, float) { return static_cast<double>(x); },
+		[](float x, float) { return float_utils::from_bfloat16(float_utils::to_bfloat16<stochastic>(x)); },
+		[](float x, float) { return float_utils::from_bfloat16(float_utils::to_bfloat16<downward>(x)); },
+		[](float x, float) { return float_utils::from_bfloat16(float_utils::to_bfloat16<upward>(x)); }
+	);
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout << "unbiased (stochastic): " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Checks the frequency of rounding up for inputs whose exact results are far below half an ulp from a representable
+// value: operands with large exponent gaps, and products deep below the subnormal range. Probability is the exact
+// position of the result between its two neighbours, which the inputs are chosen to make easy to derive
+template <typename Scalar> void check_round_up_frequency(
+	shard_result &result, std::string_view name, float x, float y, double probability, float upper,
+	std::uint32_t num_draws, Scalar &&scalar
+) {
+	std::uint32_t num_up = 0;
+	for (std::uint32_t i = 0; i < num_draws; ++i) {
+		num_up += same_result(scalar(x, y), upper) ? 1 : 0;
+	}
+	// Allow six standard deviations of the binomial distribution
+	const double mean = probability * num_draws;
+	const double tolerance = 6.0 * std::sqrt(mean * (1.0 - probability)) + 1.0;
+	std::cout <<
+		"  " << name << " " << std::hexfloat << x << " " << y << std::defaultfloat << ": rounded up " <<
+		num_up << "/" << num_draws << ", expected " << mean << "\n";
+	if (std::abs(static_cast<double>(num_up) - mean) > tolerance) {
+		std::ostringstream failure;
+		failure <<
+			name << " " << std::hexfloat << x << " " << y << std::defaultfloat << " " <<
+			probability << " " << num_up << "/" << num_draws;
+		record_failure(result, failure.str());
+	}
+}
+
+shard_result test_large_shifts(const shard_spec &spec) {
+	using enum float_utils::rounding_mode;
+	constexpr std::uint32_t num_draws = 1 << 24;
+
+	shard_result result = create_result(spec, "large_shifts", "stochastic", 7);
+	float_utils::seed_stochastic_rounding(spec.seed + result.begin);
+	const auto start = std::chrono::steady_clock::now();
+
+	// Only the cases selected by the shard spec are checked
+	std::uint64_t index = 0;
+	auto check = [&](std::string_view name, float x, float y, double probability, float upper, auto &&scalar) {
+		if (index >= result.begin && index < result.end) {
+			check_round_up_frequency(result, name, x, y, probability, upper, num_draws, scalar);
+		}
+		++index;
+	};
+	std::cout << "large_shifts (stochastic):\n";
+	// An ulp of 1 is 2^-23 above it, and 2^-24 below it
+	check("add", 1.0f, 0x1p-40f, 0x1p-17, 1.0f + 0x1p-23f, float_utils::add<stochastic>);
+	check("add", 1.0f, 0x1p-60f, 0x1p-37, 1.0f + 0x1p-23f, float_utils::add<stochastic>);
+	check("add", 1.0f, 1e-20f, static_cast<double>(1e-20f) * 0x1p23, 1.0f + 0x1p-23f, float_utils::add<stochastic>);
+	check("add", 1.0f, -0x1p-40f, 1.0 - 0x1p-16, 1.0f, float_utils::add<stochastic>);
+	// The smallest subnormal is 2^-149, and the gap to the operand below is 49 exponents
+	check("add", 0x1p-100f, 0x1p-149f, 0x1p-26, 0x1p-100f + 0x1p-123f, float_utils::add<stochastic>);
+	check("mul", 0x1p-100f, 0x1p-70f, 0x1p-21, 0x1p-149f, float_utils::mul<stochastic>);
+	check("mul", 0x1.8p-100f, 0x1p-60f, 0x1.8p-11, 0x1p-149f, float_utils::mul<stochastic>);
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	std::cout << "large_shifts (stochastic): " << result.num_failed << " failures\n";
+	return result;
+}
+
+// Accumulates many increments that are smaller than half an ulp of the sum. Rounding to nearest stagnates, while the
+// error of stochastic rounding stays within a few standard deviations. Add is a templated function object that adds
+// the increment to the sum using the given rounding mode
+template <typename Add> [[nodiscard]] bool check_accumulation(
+	std::string_view name, float initial, std::uint32_t count, float increment, Add &&add
+) {
+	using enum float_utils::rounding_mode;
+
+	float nearest_sum = initial;
+	float stochastic_sum = initial;
+	double variance = 0.0;
+	for (std::uint32_t i = 0; i < count; ++i) {
+		nearest_sum = add.template operator()<nearest_tie_to_even>(nearest_sum, increment);
+		// Each step rounds up to the upper neighbour with probability p, and contributes p(1 - p) ulp^2 to the variance
+		const double lower = add.template operator()<downward>(stochastic_sum, increment);
+		const double upper = add.template operator()<upward>(stochastic_sum, increment);
+		if (lower != upper) {
+			const double p = (static_cast<double>(stochastic_sum) + increment - lower) / (upper - lower);
+			variance += p * (1.0 - p) * (upper - lower) * (upper - lower);
+		}
+		stochastic_sum = add.template operator()<stochastic>(stochastic_sum, increment);
+	}
+	const double exact = initial + static_cast<double>(increment) * count;
+	const double tolerance = 6.0 * std::sqrt(variance);
+	std::cout <<
+		name << " accumulation: exact " << exact << ", nearest " << nearest_sum << ", stochastic " << stochastic_sum <<
+		" (tolerance " << tolerance << ")\n";
+	return std::abs(stochastic_sum - exact) <= tolerance;
+}
+
+shard_result test_accumulation(const shard_spec &spec) {
+	shard_result result = create_result(spec, "accumulation", "stochastic", 2);
+	float_utils::seed_stochastic_rounding(spec.seed + result.begin);
+	const auto start = std::chrono::steady_clock::now();
+
+	// Only the cases selected by the shard spec are checked
+	auto selects = [&](std::uint64_t index) {
+		return index >= result.begin && index < result.end;
+	};
+	if (selects(0)) {
+		const bool passed = check_accumulation(
+			"float", 1.0f, 1u << 22, 0x1p-26f,
+			[]<float_utils::rounding_mode Mode>(float sum, float increment) {
+				return float_utils::add<Mode>(sum, increment);
+			}
+		);
+		if (!passed) {
+			record_failure(result, "float");
+		}
+	}
+	// The sum is kept in bfloat16, and each step is computed exactly in float before narrowing
+	if (selects(1)) {
+		const bool passed = check_accumulation(
+			"bfloat16", 0.0f, 1u << 16, 0x1p-12f,
+			[]<float_utils::rounding_mode Mode>(float sum, float increment) {
+				return float_utils::from_bfloat16(float_utils::to_bfloat16<Mode>(sum + increment));
+			}
+		);
+		if (!passed) {
+			record_failure(result, "bfloat16");
+		}
+	}
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	result.seconds = duration.count();
+	return result;
+}
+
+// Tests that reseeding reproduces the same results, and that different seeds produce different results
+shard_result test_seeding(const shard_spec &spec) {
+	using enum float_utils::rounding_mode;
+
+	shard_result result = create_result(spec, "seeding", "stochastic", 1);
+	if (result.begin == result.end) {
+		return result;
+	}
+	const std::vector<float> x(batch_size, 1.0f);
+	const std::vector<float> y(batch_size, 0x1p-25f);
+	auto run = [&](std::uint64_t seed) {
+		std::vector<float> out(batch_size);
+		float_utils::seed_stochastic_rounding(seed);
+		float_utils::add_batch<stochastic>(x, y, out);
+		return out;
+	};
+	const std::vector<float> first = run(spec.seed);
+	if (first != run(spec.seed)) {
+		record_failure(result, "reseeding");
+	}
+	if (first == run(spec.seed + 1)) {
+		record_failure(result, "different_seeds");
+	}
+	std::cout << "seeding (stochastic): " << result.num_failed << " failures\n";
+	return result;
+}
+
+int main(int argc, char **argv) {
+	using enum float_utils::rounding_mode;
+
+	const std::optional<shard_spec> spec = parse_shard_spec(argc, argv);
+	if (!spec) {
+		return 1;
+	}
+	const telemetry_reporter reporter(spec.value());
+
+	std::vector<shard_result> results;
+	auto run = [&](std::string_view name, float_utils::rounding_mode mode, auto &&test) {
+		if (spec->selects_op(name) && spec->selects_mode(mode)) {
+			results.emplace_back(test(spec.value()));
+			write_shard_results(spec->output, results);
+		}
+	};
+	run("to_bfloat16", toward_zero, test_to_bfloat16<toward_zero>);
+	run("to_bfloat16", nearest_tie_to_even, test_to_bfloat16<nearest_tie_to_even>);
+	run("to_bfloat16", nearest_tie_to_infinity, test_to_bfloat16<nearest_tie_to_infinity>);
+	run("to_bfloat16", downward, test_to_bfloat16<downward>);
+	run("to_bfloat16", upward, test_to_bfloat16<upward>);
+	run("to_bfloat16", stochastic, test_to_bfloat16_stochastic);
+	run("add", stochastic, [](const shard_spec &s) {
+		return test_binary_stochastic(
+			s, fuzz_operator::add, "add",
+			float_utils::add<stochastic>, float_utils::add<downward>, float_utils::add<upward>,
+			float_utils::add_batch<stochastic>
+		);
+	});
+	run("mul", stochastic, [](const shard_spec &s) {
+		return test_binary_stochastic(
+			s, fuzz_operator::mul, "mul",
+			float_utils::mul<stochastic>, float_utils::mul<downward>, float_utils::mul<upward>,
+			float_utils::mul_batch<stochastic>
+		);
+	});
+	run("unbiased", stochastic, test_unbiased);
+	run("large_shifts", stochastic, test_large_shifts);
+	run("accumulation", stochastic, test_accumulation);
+	run("seeding", stochastic, test_seeding);
+
+	for (const shard_result &result : results) {
+		if (result.num_failed > 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,125 @@
+#include <bit>
+#include <cfenv>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "float_utils/add.h"
+#include "float_utils/div.h"
+#include "float_utils/instrumentation.h"
+#include "float_utils/mul.h"
+
+#include "shard.h"
+#include "triage.h"
+
+// Returns the instrumented software implementation of a fuzzed operator, or an empty function if the test is not one
+[[nodiscard]] std::function<float(float, float)> get_operator(const std::string &test, float_utils::rounding_mode mode) {
+	return dispatch_rounding_mode(mode, [&]<float_utils::rounding_mode Mode>() -> std::function<float(float, float)> {
+		if (test == "add") {
+			return float_utils::add<Mode, float_utils::path_counters>;
+		}
+		if (test == "mul") {
+			return float_utils::mul<Mode, float_utils::path_counters>;
+		}
+		if (test == "div") {
+			return float_utils::div<Mode, float_utils::path_counters>;
+		}
+		return {};
+	});
+}
+
+// Returns the hardware implementation of a fuzzed operator, or an empty function if the test is not one or the
+// rounding mode has no hardware equivalent. The hardware rounding mode is set by the caller
+[[nodiscard]] std::function<float(float, float)> get_hardware_operator(
+	const std::string &test, float_utils::rounding_mode mode
+) {
+	if (mode == float_utils::rounding_mode::nearest_tie_to_infinity || mode == float_utils::rounding_mode::stochastic) {
+		return {};
+	}
+	if (test == "add") {
+		return [](float x, float y) { return x + y; };
+	}
+	if (test == "mul") {
+		return [](float x, float y) { return x * y; };
+	}
+	if (test == "div") {
+		return [](float x, float y) { return x / y; };
+	}
+	return {};
+}
+
+// Triages the failures recorded in result files written by the fuzz executables. Each failure is replayed against the
+// current implementation, so failures that have since been fixed are only counted. Result files only keep the first
+// failures of each shard; the fuzz executables triage all of their failures as they run. Representatives are shrunk
+// using the hardware implementation where the rounding mode has one
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " RESULT_FILE...\n";
+		return 1;
+	}
+
+	std::map<std::pair<std::string, std::string>, std::vector<std::string>> failures;
+	for (int i = 1; i < argc; ++i) {
+		std::optional<std::vector<shard_result>> results = read_shard_results(argv[i]);
+		if (!results) {
+			std::cerr << "Failed to read results from " << argv[i] << "\n";
+			return 1;
+		}
+		for (shard_result &result : results.value()) {
+			std::vector<std::string> &test_failures = failures[{ result.test, result.mode }];
+			test_failures.insert(test_failures.end(), result.failures.begin(), result.failures.end());
+		}
+	}
+
+	bool any_failures = false;
+	for (const auto &[key, descriptions] : failures) {
+		const auto &[test, mode_name] = key;
+		if (descriptions.empty()) {
+			continue;
+		}
+		const std::optional<float_utils::rounding_mode> mode = parse_rounding_mode(mode_name);
+		const std::function<float(float, float)> my_ver = mode ? get_operator(test, mode.value()) : nullptr;
+		if (!my_ver) {
+			std::cout << test << " (" << mode_name << "): " << descriptions.size() << " failures, not a fuzzed operator\n";
+			continue;
+		}
+
+		// Failures are recorded as the bit patterns of x, y, the hardware result and the software result
+		std::fesetround(float_utils::to_fe_rounding_mode(mode.value()));
+		mismatch_triage triage(my_ver, get_hardware_operator(test, mode.value()));
+		std::uint64_t num_fixed = 0;
+		std::uint64_t num_malformed = 0;
+		for (const std::string &description : descriptions) {
+			std::istringstream in(description);
+			std::uint32_t x = 0;
+			std::uint32_t y = 0;
+			std::uint32_t expected = 0;
+			in >> std::hex >> x >> y >> expected;
+			if (!in) {
+				++num_malformed;
+			} else if (!triage.add(std::bit_cast<float>(x), std::bit_cast<float>(y), std::bit_cast<float>(expected))) {
+				++num_fixed;
+			}
+		}
+		if (triage.get_num_mismatches() > 0) {
+			triage.write_report(std::cout, test, mode_name);
+			any_failures = true;
+		}
+		if (num_fixed > 0) {
+			std::cout << test << " (" << mode_name << "): " << num_fixed << " recorded failures no longer fail\n";
+		}
+		if (num_malformed > 0) {
+			std::cout << test << " (" << mode_name << "): " << num_malformed << " malformed failures\n";
+		}
+	}
+	if (!any_failures) {
+		std::cout << "No failures to triage\n";
+	}
+	return any_failures ? 1 : 0;
+}
@@ -1,13 +1,106 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <cstdint>
+#include <span>
 #include <utility>
 
+#include "category.h"
+#include "dispatch.h"
 #include "utils.h"
 #include "float_parts.h"
 
 namespace float_utils {
-	template <rounding_mode Rounding = rounding_mode::system> inline float add(float x, float y) {
+	namespace _details {
+		// Adds two numbers given their exponents and fractions. The absolute value of x must be at least that of y.
+		// Fractions are shifted left by one bit, and their implicit bits should only be set for normal numbers.
+		// Subnormal numbers should use an exponent of 1
+		template <rounding_mode Rounding, typename Instrumentation> constexpr float add_aligned(
+			std::uint32_t xe, std::uint32_t xf, bool xp, std::uint32_t ye, std::uint32_t yf, bool yp
+		) {
+			const rounding_mode rounding = Rounding == rounding_mode::system ? get_system_rounding_mode() : Rounding;
+
+			// y needs to be shifted right this many bits to align with x, clamped at 63
+			const std::uint32_t yfshiftr_bits = std::min(xe - ye, 63u);
+			// Record the bits that have been truncated from y during the shift with their exact weight, which
+			// stochastic rounding depends on. Bits shifted past the 32 truncated bits are kept as a sticky bit
+			const std::uint64_t yf_aligned = (static_cast<std::uint64_t>(yf) << 32) >> yfshiftr_bits;
+			const bool yf_lost = yfshiftr_bits > 32 && (yf << (64 - yfshiftr_bits)) != 0;
+			std::uint32_t truncated_bits = static_cast<std::uint32_t>(yf_aligned) | (yf_lost ? 1u : 0u);
+			std::uint32_t yfv_pos = static_cast<std::uint32_t>(yf_aligned >> 32);
+			// In the case that y is subtracted from x, increment y's fraction and negate the truncated the bits so that
+			// we always round towards the positive direction. This simplifies rounding by a lot
+			if (truncated_bits && xp != yp) {
+				++yfv_pos;
+				truncated_bits = ~truncated_bits + 1u;
+			}
+
+			// Resulting fraction, guaranteed to be larger than 0 due to the swap
+			// Negate y's fraction if the signs are different
+			const std::uint32_t rf_raw = xp == yp ? xf + yfv_pos : xf - yfv_pos;
+			if (rf_raw == 0) {
+				Instrumentation::hit(operator_path::add_cancellation);
+				// Exact cancellation produces -0 only when rounding downward
+				return rounding == rounding_mode::downward ? -0.0f : 0.0f;
+			}
+
+			const std::uint32_t re_offset = std::countl_zero(rf_raw);
+			if (re_offset < 32 - (float_parts::num_fraction_bits + 1)) {
+				// In this case, we have produced extra bits. Merge them into the truncated bits
+				Instrumentation::hit(operator_path::add_extra_bit);
+				const std::uint32_t extra_bits = 32 - (re_offset + float_parts::num_fraction_bits + 1);
+				const std::uint32_t sticky = (truncated_bits << (32 - extra_bits)) != 0 ? 1u : 0u;
+				truncated_bits = (rf_raw << (32 - extra_bits)) | (truncated_bits >> extra_bits) | sticky;
+			}
+
+			const bool rp = xp;
+			const std::int32_t re_raw =
+				static_cast<std::int32_t>(xe + (30 - float_parts::num_fraction_bits)) -
+				static_cast<std::int32_t>(re_offset);
+			std::uint32_t rf = (rf_raw << re_offset) >> (31u - float_parts::num_fraction_bits);
+			std::uint32_t re = static_cast<std::uint32_t>(re_raw);
+			if (re_raw <= 0) [[unlikely]] {
+				// The result is subnormal
+				Instrumentation::hit(operator_path::add_subnormal_result);
+				denormalize(rf, truncated_bits, static_cast<std::uint32_t>(1 - re_raw));
+				re = 0;
+			}
+			const bool is_inf = (re >= (1u << float_parts::num_exponent_bits) - 1);
+
+			// Round and return
+			return round_result<Instrumentation>(rounding, rp, re, rf, truncated_bits, is_inf);
+		}
+
+		// Handles the case where y is zero or subnormal. The absolute value of x must be at least that of y
+		template <rounding_mode Rounding, typename Instrumentation> constexpr float add_subnormal(float x, float y) {
+			const bool xp = float_parts::get_sign(x);
+			const bool yp = float_parts::get_sign(y);
+			if (is_zero(y)) {
+				if (!is_zero(x) || xp == yp) {
+					return x;
+				}
+				// Zeros with different signs
+				const rounding_mode rounding =
+					Rounding == rounding_mode::system ? get_system_rounding_mode() : Rounding;
+				return rounding == rounding_mode::downward ? -0.0f : 0.0f;
+			}
+
+			// Subnormal numbers have the same exponent as the smallest normal numbers, but without the implicit bit
+			std::uint32_t xe = float_parts::get_exponent(x);
+			std::uint32_t xf = float_parts::get_fraction(x) << 1;
+			if (xe == 0) {
+				xe = 1;
+			} else {
+				xf |= 2u << float_parts::num_fraction_bits;
+			}
+			return add_aligned<Rounding, Instrumentation>(xe, xf, xp, 1, float_parts::get_fraction(y) << 1, yp);
+		}
+	}
+
+	template <
+		rounding_mode Rounding = rounding_mode::system, typename Instrumentation = no_instrumentation
+	> constexpr float add(float x, float y) {
 		std::uint32_t xe = float_parts::get_exponent(x);
 		std::uint32_t ye = float_parts::get_exponent(y);
 
@@ -20,54 +113,47 @@ namespace float_utils {
 		// Swap if necessary to make sure that the absolute value of x is larger than that of y
 		const bool swap_xy = xe == ye ? xf < yf : xe < ye;
 		if (swap_xy) {
+			Instrumentation::hit(operator_path::add_swap);
 			std::swap(xe, ye);
 			std::swap(xf, yf);
 			std::swap(x, y);
 		}
-		if (ye == 0) {
-			return x;
+		if (ye == 0) [[unlikely]] {
+			Instrumentation::hit(operator_path::add_subnormal_operand);
+			return _details::add_subnormal<Rounding, Instrumentation>(x, y);
 		}
 
-		const bool xp = float_parts::get_sign(x);
-		const bool yp = float_parts::get_sign(y);
-
-		// y needs to be shifted right this many bits to align with x, clamped at 31
-		const std::uint32_t yfshiftr_bits = std::min(xe - ye, 31u);
-		// Record any 1 bits that have been truncated from y during the shift
-		std::uint32_t truncated_bits = yfshiftr_bits == 0 ? 0 : (yf << (32 - yfshiftr_bits));
-		std::uint32_t yfv_pos = yf >> yfshiftr_bits;
-		// In the case that y is subtracted from x, increment y's fraction and negate the truncated the bits so that
-		// we always round towards the positive direction. This simplifies rounding by a lot
-		if (truncated_bits && xp != yp) {
-			++yfv_pos;
-			truncated_bits = ~truncated_bits + 1u;
-		}
+		return _details::add_aligned<Rounding, Instrumentation>(
+			xe, xf, float_parts::get_sign(x), ye, yf, float_parts::get_sign(y)
+		);
+	}
+	template <
+		rounding_mode RoundingMode = rounding_mode::system, typename Instrumentation = no_instrumentation
+	> constexpr float sub(float x, float y) {
+		return add<RoundingMode, Instrumentation>(x, -y);
+	}
 
-		// Resulting fraction, guaranteed to be larger than 0 due to the swap
-		// Negate y's fraction if the signs are different
-		const std::uint32_t rf_raw = xp == yp ? xf + yfv_pos : xf - yfv_pos;
-		if (rf_raw == 0) {
-			return 0.0f;
-		}
+	namespace _details {
+		template <rounding_mode Rounding> struct add_batch_kernel {
+			constexpr void operator()(std::span<const float> x, std::span<const float> y, std::span<float> out) const {
+				for (std::size_t i = 0; i < x.size(); ++i) {
+					out[i] = add<Rounding>(x[i], y[i]);
+				}
+			}
+		};
+	}
 
-		const std::uint32_t re_offset = std::countl_zero(rf_raw);
-		if (re_offset < 32 - (float_parts::num_fraction_bits + 1)) {
-			// In this case, we have produced extra bits. Merge them into the truncated bits
-			truncated_bits =
-				(rf_raw << (re_offset + float_parts::num_fraction_bits + 1)) |
-				(truncated_bits >> (32 - (re_offset + float_parts::num_fraction_bits + 1)));
+	// Computes add(x[i], y[i]) for all elements using the instruction set chosen by get_simd_level(). All spans must
+	// have the same size. With stochastic rounding, elements are rounded in order using the random stream of the
+	// current thread, so the results are the same as calling add() on each element in turn
+	template <rounding_mode Rounding = rounding_mode::system> constexpr void add_batch(
+		std::span<const float> x, std::span<const float> y, std::span<float> out
+	) {
+		using kernel = _details::add_batch_kernel<Rounding>;
+		if (std::is_constant_evaluated()) {
+			kernel{}(x, y, out);
+		} else {
+			_details::dispatch_kernel<kernel>(x, y, out);
 		}
-
-		const bool rp = xp;
-		const std::uint32_t re = xe + (30 - re_offset - float_parts::num_fraction_bits);
-		const std::uint32_t rf = (rf_raw << re_offset) >> (31u - float_parts::num_fraction_bits);
-		const bool is_inf = (re >= (1u << float_parts::num_exponent_bits) - 1);
-
-		// Round and return
-		const rounding_mode rounding = Rounding == rounding_mode::system ? get_system_rounding_mode() : Rounding;
-		return round_result(rounding, rp, re, rf, truncated_bits, is_inf);
-	}
-	template <rounding_mode RoundingMode = rounding_mode::system> inline float sub(float x, float y) {
-		return add<RoundingMode>(x, -y);
 	}
 }
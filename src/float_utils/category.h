@@ -14,4 +14,12 @@ namespace float_utils {
 			(std::bit_cast<std::uint32_t>(x) & float_parts::exponent_mask) == float_parts::exponent_mask &&
 			float_parts::get_fraction(x) != 0;
 	}
+
+	[[nodiscard]] constexpr bool is_zero(float x) {
+		return (std::bit_cast<std::uint32_t>(x) & ~float_parts::sign_mask) == 0;
+	}
+
+	[[nodiscard]] constexpr bool is_subnormal(float x) {
+		return float_parts::get_exponent(x) == 0 && float_parts::get_fraction(x) != 0;
+	}
 }
@@ -1,111 +1,265 @@
 #pragma once
 
+#include <algorithm>
 #include <bit>
+#include <concepts>
+#include <cstdint>
+#include <limits>
 #include <optional>
+#include <span>
+#include <type_traits>
 
+#include "dispatch.h"
 #include "float_parts.h"
 #include "utils.h"
 
 namespace float_utils {
+	// Integer types that can be converted to and from floats
+	template <typename Int> concept conversion_integer =
+		std::integral<Int> && !std::same_as<Int, bool> && (sizeof(Int) == 4 || sizeof(Int) == 8);
+
+	// Flags describing the outcome of converting a float to an integer, similar to floating point exception flags
+	namespace conversion_status {
+		using type = std::uint8_t;
+
+		constexpr type exact = 0;
+		constexpr type inexact = 1 << 0; // The value has been rounded
+		constexpr type overflow = 1 << 1; // The value is out of range and has been saturated
+		constexpr type invalid = 1 << 2; // The value is NaN and has been converted to 0
+	}
+
 	template <
-		rounding_mode RoundingMode = rounding_mode::nearest_tie_to_even
-	> constexpr float to_float(std::int32_t sx) {
-		if (sx == 0) {
-			return 0.0f;
-		}
+		rounding_mode RoundingMode = rounding_mode::nearest_tie_to_even, conversion_integer Int
+	> constexpr float to_float(Int sx) {
+		using uint = std::make_unsigned_t<Int>;
+		constexpr std::uint32_t num_bits = sizeof(Int) * 8;
+
 		const bool sign = sx < 0;
-		const auto bx = std::bit_cast<std::uint32_t>(sx);
+		const auto bx = static_cast<uint>(sx);
 		// Since negating a negative number may overflow, we do it manually here
-		const auto x = sign ? ~bx + 1 : bx;
-		// Find the highest bit
-		const std::uint32_t bits = 32u - std::countl_zero(x);
+		const uint x = sign ? ~bx + 1 : bx;
+		// Shift the highest bit to the top. The lowest bit is set so that zero is not shifted by the full width, which
+		// does not change the position of the highest bit of any other value
+		const std::uint32_t zeros = std::countl_zero(static_cast<uint>(x | 1u));
+		const uint x_norm = x << zeros;
 		// Compute exponent based on highest bit
-		const std::uint32_t exponent = bits - 1 + float_parts::exponent_offset;
+		const std::uint32_t exponent = num_bits - 1 - zeros + float_parts::exponent_offset;
 
-		std::uint32_t fraction;
-		std::uint32_t round_inc = 0;
-		if (bits <= float_parts::num_fraction_bits + 1u) {
-			fraction = x << (float_parts::num_fraction_bits + 1u - bits);
+		// Truncation means rounding towards zero
+		const auto fraction = static_cast<std::uint32_t>(x_norm >> (num_bits - (float_parts::num_fraction_bits + 1)));
+		const uint truncated_bits_full = x_norm << (float_parts::num_fraction_bits + 1);
+		std::uint32_t truncated_bits;
+		if constexpr (num_bits == 32) {
+			truncated_bits = truncated_bits_full;
 		} else {
-			const std::uint32_t shr_bits = bits - float_parts::num_fraction_bits - 1u;
-			// Truncation means rounding towards zero
-			fraction = x >> shr_bits;
-
-			const rounding_mode rounding =
-				RoundingMode == rounding_mode::system ? get_system_rounding_mode() : RoundingMode;
-			switch (rounding) {
-			case rounding_mode::downward:
-				// Round negative numbers up
-				if (sign) {
-					if (x & ((1u << shr_bits) - 1u)) {
-						round_inc = 1;
-					}
+			// Keep the lowest bit as a sticky bit
+			truncated_bits =
+				static_cast<std::uint32_t>(truncated_bits_full >> 32) |
+				(static_cast<std::uint32_t>(truncated_bits_full) != 0 ? 1u : 0u);
+		}
+
+		const rounding_mode rounding =
+			RoundingMode == rounding_mode::system ? get_system_rounding_mode() : RoundingMode;
+		const float result = round_result(rounding, sign, exponent, fraction, truncated_bits, false);
+		return x == 0 ? 0.0f : result;
+	}
+
+	template <
+		conversion_integer Int = std::int32_t, rounding_mode RoundingMode = rounding_mode::toward_zero
+	> constexpr Int to_int_saturate(float f, conversion_status::type &status) {
+		using uint = std::make_unsigned_t<Int>;
+		constexpr std::uint32_t num_bits = sizeof(Int) * 8;
+		constexpr auto num_fraction_bits = static_cast<std::int32_t>(float_parts::num_fraction_bits);
+
+		// This function is written without branches so that batch conversions can be vectorized
+		const bool sign = float_parts::get_sign(f);
+		const std::uint32_t biased_exponent = float_parts::get_exponent(f);
+		const std::int32_t exponent = float_parts::get_offset_exponent(f);
+		const std::uint32_t fraction =
+			float_parts::get_fraction(f) | (biased_exponent != 0 ? 1u << float_parts::num_fraction_bits : 0u);
+
+		// Integer part of the absolute value, and the bits after the decimal point with the highest bit representing
+		// 0.5. Values smaller than 2^-9 only need to produce non-zero truncated bits for correct rounding
+		const auto shl_bits = static_cast<std::uint32_t>(std::clamp<std::int32_t>(
+			exponent - num_fraction_bits, 0, static_cast<std::int32_t>(num_bits) - 1
+		));
+		const auto shr_bits = static_cast<std::uint32_t>(std::clamp<std::int32_t>(
+			num_fraction_bits - exponent, 0, 31
+		));
+		const auto trunc_shl_bits = static_cast<std::uint32_t>(std::clamp<std::int32_t>(
+			exponent + (32 - num_fraction_bits), 0, 31
+		));
+		// At most one of the shifts is non-zero. Values below 1 are shifted right by 31 bits, which clears them
+		const auto int_part = static_cast<uint>(static_cast<uint>(static_cast<uint>(fraction) << shl_bits) >> shr_bits);
+		const std::uint32_t truncated_bits =
+			exponent >= num_fraction_bits ? 0u :
+			exponent >= num_fraction_bits - 32 ? fraction << trunc_shl_bits :
+			(fraction != 0 ? 1u : 0u);
+
+		const rounding_mode rounding =
+			RoundingMode == rounding_mode::system ? get_system_rounding_mode() : RoundingMode;
+		const std::uint32_t increment = _details::rounding_increment(rounding, sign, int_part & 1u, truncated_bits);
+		const uint abs_value = int_part + increment;
+
+		// Since negative values of signed integers have a larger range, the limit depends on the sign. For both signed
+		// and unsigned integers, adding 1 to the maximum value produces the bit pattern of the minimum value, which
+		// also equals the magnitude of the minimum value
+		const uint sign_bit = std::bit_cast<std::uint32_t>(f) >> 31;
+		const uint limit = static_cast<uint>(std::numeric_limits<Int>::max()) + sign_bit;
+		// Flags are computed as integers using non-short-circuiting operators to avoid introducing branches
+		const std::uint32_t nan_flag =
+			static_cast<std::uint32_t>(biased_exponent == (1u << float_parts::num_exponent_bits) - 1) &
+			static_cast<std::uint32_t>(float_parts::get_fraction(f) != 0);
+		// abs_value > limit is computed from int_part, since GCC fails to vectorize the comparison after rounding
+		const std::uint32_t overflow_flag = (nan_flag ^ 1u) & (
+			static_cast<std::uint32_t>(exponent >= static_cast<std::int32_t>(num_bits)) |
+			static_cast<std::uint32_t>(int_part > limit) |
+			(static_cast<std::uint32_t>(int_part == limit) & increment)
+		);
+		const std::uint32_t inexact_flag =
+			((nan_flag | overflow_flag) ^ 1u) & static_cast<std::uint32_t>(truncated_bits != 0);
+		status = static_cast<conversion_status::type>(
+			nan_flag * conversion_status::invalid |
+			overflow_flag * conversion_status::overflow |
+			inexact_flag * conversion_status::inexact
+		);
+
+		// Negate using the sign bit instead of selecting based on it, which helps vectorization
+		const uint value = (abs_value ^ (0u - sign_bit)) + sign_bit;
+		return static_cast<Int>(nan_flag ? 0u : overflow_flag ? limit : value);
+	}
+	template <
+		conversion_integer Int = std::int32_t, rounding_mode RoundingMode = rounding_mode::toward_zero
+	> constexpr Int to_int_saturate(float f) {
+		conversion_status::type status = conversion_status::exact;
+		return to_int_saturate<Int, RoundingMode>(f, status);
+	}
+
+	// Returns std::nullopt if the value is NaN or out of range
+	template <
+		conversion_integer Int = std::int32_t, rounding_mode RoundingMode = rounding_mode::toward_zero
+	> constexpr std::optional<Int> to_int(float f) {
+		conversion_status::type status = conversion_status::exact;
+		const Int result = to_int_saturate<Int, RoundingMode>(f, status);
+		if (status & (conversion_status::overflow | conversion_status::invalid)) {
+			return std::nullopt;
+		}
+		return result;
+	}
+
+	// bfloat16 values are stored as their bit patterns. The format keeps the sign and exponent of a float and the top
+	// 7 bits of its fraction, so narrowing only needs to round away the low 16 bits
+	using bfloat16_bits = std::uint16_t;
+
+	template <rounding_mode RoundingMode = rounding_mode::nearest_tie_to_even> constexpr bfloat16_bits to_bfloat16(
+		float f
+	) {
+		const std::uint32_t bits = std::bit_cast<std::uint32_t>(f);
+		const std::uint32_t sign_bit = bits >> 31;
+		const std::uint32_t magnitude = (bits & ~float_parts::sign_mask) >> 16;
+		const std::uint32_t truncated_bits = bits << 16;
+		const bool is_nan = (bits & ~float_parts::sign_mask) > float_parts::exponent_mask;
+
+		// Incrementing the largest finite value carries into the exponent and produces infinity
+		const rounding_mode rounding =
+			RoundingMode == rounding_mode::system ? get_system_rounding_mode() : RoundingMode;
+		const std::uint32_t increment =
+			is_nan ? 0u : _details::rounding_increment(rounding, sign_bit != 0, magnitude & 1u, truncated_bits);
+		const std::uint32_t rounded = magnitude + increment;
+		// NaNs keep their payload and are made quiet, so that truncating the payload cannot produce infinity
+		return static_cast<bfloat16_bits>((sign_bit << 15) | rounded | (is_nan ? 0x40u : 0u));
+	}
+	// Widening is always exact
+	[[nodiscard]] constexpr float from_bfloat16(bfloat16_bits b) {
+		return std::bit_cast<float>(static_cast<std::uint32_t>(b) << 16);
+	}
+
+
+	namespace _details {
+		template <rounding_mode RoundingMode, conversion_integer Int> struct to_float_batch_kernel {
+			constexpr void operator()(std::span<const Int> in, std::span<float> out) const {
+				for (std::size_t i = 0; i < in.size(); ++i) {
+					out[i] = to_float<RoundingMode>(in[i]);
 				}
-				break;
-			case rounding_mode::upward:
-				// Round positive numbers up
-				if (!sign) {
-					if (x & ((1u << shr_bits) - 1u)) {
-						round_inc = 1;
-					}
+			}
+		};
+
+		template <conversion_integer Int, rounding_mode RoundingMode> struct to_int_saturate_batch_kernel {
+			constexpr void operator()(std::span<const float> in, std::span<Int> out) const {
+				for (std::size_t i = 0; i < in.size(); ++i) {
+					out[i] = to_int_saturate<Int, RoundingMode>(in[i]);
 				}
-				break;
-			case rounding_mode::nearest_tie_to_even:
-				{
-					const std::uint32_t tie_bit = 1u << (shr_bits - 1u);
-					if (x & tie_bit) {
-						if ((x & (tie_bit - 1u)) == 0) {
-							// A tie - round to nearest value with an even least significant digit
-							round_inc = (x & (tie_bit << 1u)) == 0 ? 0u : 1u;
-						} else {
-							round_inc = 1;
-						}
-					}
+			}
+			constexpr conversion_status::type operator()(
+				std::span<const float> in, std::span<Int> out, std::span<conversion_status::type> status
+			) const {
+				conversion_status::type all_status = conversion_status::exact;
+				for (std::size_t i = 0; i < in.size(); ++i) {
+					conversion_status::type cur_status = conversion_status::exact;
+					out[i] = to_int_saturate<Int, RoundingMode>(in[i], cur_status);
+					status[i] = cur_status;
+					all_status |= cur_status;
 				}
-				break;
-			case rounding_mode::nearest_tie_to_infinity:
-				if (x & (1u << (shr_bits - 1u))) {
-					round_inc = 1;
+				return all_status;
+			}
+		};
+
+		template <rounding_mode RoundingMode> struct to_bfloat16_batch_kernel {
+			constexpr void operator()(std::span<const float> in, std::span<bfloat16_bits> out) const {
+				for (std::size_t i = 0; i < in.size(); ++i) {
+					out[i] = to_bfloat16<RoundingMode>(in[i]);
 				}
-				break;
-			case rounding_mode::toward_zero:
-				break;
 			}
+		};
+	}
+
+	// Batch conversions, using the instruction set chosen by get_simd_level(). The input and output spans must have
+	// the same size
+
+	template <
+		rounding_mode RoundingMode = rounding_mode::nearest_tie_to_even, conversion_integer Int
+	> constexpr void to_float_batch(std::span<const Int> in, std::span<float> out) {
+		using kernel = _details::to_float_batch_kernel<RoundingMode, Int>;
+		if (std::is_constant_evaluated()) {
+			kernel{}(in, out);
+		} else {
+			_details::dispatch_kernel<kernel>(in, out);
 		}
-		const std::uint32_t res_unsigned = float_parts::assemble_bits(false, exponent, fraction) + round_inc;
-		return std::bit_cast<float>(sign ? float_parts::sign_mask | res_unsigned : res_unsigned);
 	}
 
-	constexpr std::optional<std::int32_t> to_int(float f) {
-		const bool sign = float_parts::get_sign(f);
-		const std::uint32_t offset_exponent = float_parts::get_exponent(f);
-		if (offset_exponent < float_parts::exponent_offset) {
-			// Value too small; truncate to 0
-			return 0;
+	template <
+		conversion_integer Int, rounding_mode RoundingMode = rounding_mode::toward_zero
+	> constexpr void to_int_saturate_batch(std::span<const float> in, std::span<Int> out) {
+		using kernel = _details::to_int_saturate_batch_kernel<Int, RoundingMode>;
+		if (std::is_constant_evaluated()) {
+			kernel{}(in, out);
+		} else {
+			_details::dispatch_kernel<kernel>(in, out);
 		}
-		const std::uint32_t exponent = offset_exponent - float_parts::exponent_offset;
-		if (exponent >= 32) { // Value too large
-			return std::nullopt;
+	}
+
+	// Writes the status of each conversion to the status span, and returns the union of all status flags
+	template <
+		conversion_integer Int, rounding_mode RoundingMode = rounding_mode::toward_zero
+	> constexpr conversion_status::type to_int_saturate_batch(
+		std::span<const float> in, std::span<Int> out, std::span<conversion_status::type> status
+	) {
+		using kernel = _details::to_int_saturate_batch_kernel<Int, RoundingMode>;
+		if (std::is_constant_evaluated()) {
+			return kernel{}(in, out, status);
 		}
+		return _details::dispatch_kernel<kernel>(in, out, status);
+	}
 
-		const std::uint32_t fraction = float_parts::get_fraction(f) | (1u << float_parts::num_fraction_bits);
-		if (exponent <= float_parts::num_fraction_bits) {
-			const std::uint32_t abs_value = fraction >> (float_parts::num_fraction_bits - exponent);
-			return std::bit_cast<std::int32_t>(sign ? ~abs_value + 1 : abs_value);
+	// With stochastic rounding, elements are rounded in order using the random stream of the current thread
+	template <
+		rounding_mode RoundingMode = rounding_mode::nearest_tie_to_even
+	> constexpr void to_bfloat16_batch(std::span<const float> in, std::span<bfloat16_bits> out) {
+		using kernel = _details::to_bfloat16_batch_kernel<RoundingMode>;
+		if (std::is_constant_evaluated()) {
+			kernel{}(in, out);
 		} else {
-			const std::uint32_t abs_value = fraction << (exponent - float_parts::num_fraction_bits);
-			// We need additional checks because signed integers have a smaller, asymmetric value range
-			if (sign) {
-				if (abs_value > 0x80000000u) { // Value too large
-					return std::nullopt;
-				}
-				return std::bit_cast<std::int32_t>(~abs_value + 1u);
-			} else {
-				if (abs_value >= 0x80000000u) { // Value too large
-					return std::nullopt;
-				}
-				return std::bit_cast<std::int32_t>(abs_value);
-			}
+			_details::dispatch_kernel<kernel>(in, out);
 		}
 	}
 }
@@ -0,0 +1,850 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+#include "category.h"
+#include "float_parts.h"
+#include "utils.h"
+
+namespace float_utils {
+	namespace _details {
+		// Returns the high 64 bits of the product, and stores the low 64 bits in low
+		[[nodiscard]] constexpr std::uint64_t multiply_wide(std::uint64_t x, std::uint64_t y, std::uint64_t &low) {
+			const std::uint64_t x_lo = x & 0xFFFFFFFFu;
+			const std::uint64_t x_hi = x >> 32;
+			const std::uint64_t y_lo = y & 0xFFFFFFFFu;
+			const std::uint64_t y_hi = y >> 32;
+			const std::uint64_t lo_lo = x_lo * y_lo;
+			const std::uint64_t hi_lo = x_hi * y_lo;
+			const std::uint64_t lo_hi = x_lo * y_hi;
+			const std::uint64_t hi_hi = x_hi * y_hi;
+			const std::uint64_t middle = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFu) + lo_hi;
+			low = (middle << 32) | (lo_lo & 0xFFFFFFFFu);
+			return hi_hi + (hi_lo >> 32) + (middle >> 32);
+		}
+
+		// Unsigned integer with a fixed number of 32-bit limbs, least significant first. Used to compute the tables
+		// below at compile time, and to parse decimal numbers that cannot be rounded using 64-bit arithmetic. Large
+		// enough for 120 significant digits scaled to the range of floats
+		struct decimal_bignum {
+			constexpr static std::size_t num_limbs = 20;
+
+			std::array<std::uint32_t, num_limbs> limbs{};
+
+			[[nodiscard]] constexpr static decimal_bignum power_of_two(std::uint32_t exponent) {
+				decimal_bignum result;
+				result.limbs[exponent / 32] = 1u << (exponent % 32);
+				return result;
+			}
+
+			constexpr void multiply_add(std::uint32_t factor, std::uint32_t addend) {
+				std::uint64_t carry = addend;
+				for (std::uint32_t &limb : limbs) {
+					carry += static_cast<std::uint64_t>(limb) * factor;
+					limb = static_cast<std::uint32_t>(carry);
+					carry >>= 32;
+				}
+			}
+			// Divides in place and returns the remainder
+			constexpr std::uint32_t divide(std::uint32_t divisor) {
+				std::uint64_t remainder = 0;
+				for (std::size_t i = num_limbs; i > 0; --i) {
+					const std::uint64_t current = (remainder << 32) | limbs[i - 1];
+					limbs[i - 1] = static_cast<std::uint32_t>(current / divisor);
+					remainder = current % divisor;
+				}
+				return static_cast<std::uint32_t>(remainder);
+			}
+			constexpr void subtract(const decimal_bignum &rhs) {
+				std::uint64_t borrow = 0;
+				for (std::size_t i = 0; i < num_limbs; ++i) {
+					const std::uint64_t difference = static_cast<std::uint64_t>(limbs[i]) - rhs.limbs[i] - borrow;
+					limbs[i] = static_cast<std::uint32_t>(difference);
+					borrow = (difference >> 32) & 1u;
+				}
+			}
+			constexpr void shift_left(std::uint32_t bits) {
+				const std::uint32_t limb_shift = bits / 32;
+				const std::uint32_t bit_shift = bits % 32;
+				for (std::size_t i = num_limbs; i > 0; --i) {
+					const std::size_t dst = i - 1;
+					std::uint32_t value = 0;
+					if (dst >= limb_shift) {
+						value = limbs[dst - limb_shift] << bit_shift;
+						if (bit_shift != 0 && dst > limb_shift) {
+							value |= limbs[dst - limb_shift - 1] >> (32 - bit_shift);
+						}
+					}
+					limbs[dst] = value;
+				}
+			}
+			constexpr void shift_right(std::uint32_t bits) {
+				const std::uint32_t limb_shift = bits / 32;
+				const std::uint32_t bit_shift = bits % 32;
+				for (std::size_t dst = 0; dst < num_limbs; ++dst) {
+					std::uint32_t value = 0;
+					if (dst + limb_shift < num_limbs) {
+						value = limbs[dst + limb_shift] >> bit_shift;
+						if (bit_shift != 0 && dst + limb_shift + 1 < num_limbs) {
+							value |= limbs[dst + limb_shift + 1] << (32 - bit_shift);
+						}
+					}
+					limbs[dst] = value;
+				}
+			}
+
+			[[nodiscard]] constexpr bool get_bit(std::uint32_t position) const {
+				return position < num_limbs * 32 && ((limbs[position / 32] >> (position % 32)) & 1u) != 0;
+			}
+			// Number of bits needed to represent the value, or 0 for zero
+			[[nodiscard]] constexpr std::uint32_t bit_width() const {
+				for (std::size_t i = num_limbs; i > 0; --i) {
+					if (limbs[i - 1] != 0) {
+						return static_cast<std::uint32_t>((i - 1) * 32 + std::bit_width(limbs[i - 1]));
+					}
+				}
+				return 0;
+			}
+			// Returns the 64 bits starting from the given position, which may be negative
+			[[nodiscard]] constexpr std::uint64_t get_bits(std::int32_t position) const {
+				std::uint64_t result = 0;
+				for (std::int32_t i = 63; i >= 0; --i) {
+					const std::int32_t bit = position + i;
+					result = (result << 1) | (bit >= 0 && get_bit(static_cast<std::uint32_t>(bit)) ? 1u : 0u);
+				}
+				return result;
+			}
+			// Returns whether any bit below the given position is set
+			[[nodiscard]] constexpr bool any_bits_below(std::int32_t position) const {
+				for (std::int32_t i = 0; i < position; ++i) {
+					if (get_bit(static_cast<std::uint32_t>(i))) {
+						return true;
+					}
+				}
+				return false;
+			}
+
+			[[nodiscard]] friend constexpr bool operator<(const decimal_bignum &lhs, const decimal_bignum &rhs) {
+				for (std::size_t i = num_limbs; i > 0; --i) {
+					if (lhs.limbs[i - 1] != rhs.limbs[i - 1]) {
+						return lhs.limbs[i - 1] < rhs.limbs[i - 1];
+					}
+				}
+				return false;
+			}
+		};
+
+		[[nodiscard]] constexpr decimal_bignum power_of_ten_bignum(std::uint32_t exponent) {
+			decimal_bignum result;
+			result.limbs[0] = 1;
+			for (std::uint32_t i = 0; i < exponent; ++i) {
+				result.multiply_add(10, 0);
+			}
+			return result;
+		}
+	}
+
+
+	// Shortest round-trip formatting, using the Ryu algorithm by Ulf Adams specialized for floats
+	namespace _details {
+		constexpr std::int32_t ryu_pow5_inv_bit_count = 59;
+		constexpr std::int32_t ryu_pow5_bit_count = 61;
+
+		// 5^i scaled to ryu_pow5_bit_count bits, and 2^k / 5^i rounded up and scaled to ryu_pow5_inv_bit_count bits.
+		// Generating the tables at compile time is slow, so they are written out below, and are checked against the
+		// generators by exec_decimal
+		[[nodiscard]] constexpr std::array<std::uint64_t, 48> generate_ryu_pow5_split() {
+			std::array<std::uint64_t, 48> result{};
+			decimal_bignum pow5 = power_of_ten_bignum(0);
+			for (std::uint64_t &entry : result) {
+				entry = pow5.get_bits(static_cast<std::int32_t>(pow5.bit_width()) - ryu_pow5_bit_count);
+				pow5.multiply_add(5, 0);
+			}
+			return result;
+		}
+		[[nodiscard]] constexpr std::array<std::uint64_t, 31> generate_ryu_pow5_inv_split() {
+			std::array<std::uint64_t, 31> result{};
+			decimal_bignum pow5 = power_of_ten_bignum(0);
+			for (std::uint32_t i = 0; i < result.size(); ++i) {
+				decimal_bignum quotient = decimal_bignum::power_of_two(pow5.bit_width() - 1 + ryu_pow5_inv_bit_count);
+				for (std::uint32_t j = 0; j < i; ++j) {
+					quotient.divide(5);
+				}
+				result[i] = quotient.get_bits(0) + 1;
+				pow5.multiply_add(5, 0);
+			}
+			return result;
+		}
+		constexpr std::array<std::uint64_t, 48> ryu_pow5_split{
+			0x1000000000000000ull, 0x1400000000000000ull, 0x1900000000000000ull, 0x1f40000000000000ull,
+			0x1388000000000000ull, 0x186a000000000000ull, 0x1e84800000000000ull, 0x1312d00000000000ull,
+			0x17d7840000000000ull, 0x1dcd650000000000ull, 0x12a05f2000000000ull, 0x174876e800000000ull,
+			0x1d1a94a200000000ull, 0x12309ce540000000ull, 0x16bcc41e90000000ull, 0x1c6bf52634000000ull,
+			0x11c37937e0800000ull, 0x16345785d8a00000ull, 0x1bc16d674ec80000ull, 0x1158e460913d0000ull,
+			0x15af1d78b58c4000ull, 0x1b1ae4d6e2ef5000ull, 0x10f0cf064dd59200ull, 0x152d02c7e14af680ull,
+			0x1a784379d99db420ull, 0x108b2a2c28029094ull, 0x14adf4b7320334b9ull, 0x19d971e4fe8401e7ull,
+			0x1027e72f1f128130ull, 0x1431e0fae6d7217cull, 0x193e5939a08ce9dbull, 0x1f8def8808b02452ull,
+			0x13b8b5b5056e16b3ull, 0x18a6e32246c99c60ull, 0x1ed09bead87c0378ull, 0x13426172c74d822bull,
+			0x1812f9cf7920e2b6ull, 0x1e17b84357691b64ull, 0x12ced32a16a1b11eull, 0x178287f49c4a1d66ull,
+			0x1d6329f1c35ca4bfull, 0x125dfa371a19e6f7ull, 0x16f578c4e0a060b5ull, 0x1cb2d6f618c878e3ull,
+			0x11efc659cf7d4b8dull, 0x166bb7f0435c9e71ull, 0x1c06a5ec5433c60dull, 0x118427b3b4a05bc8ull
+		};
+		constexpr std::array<std::uint64_t, 31> ryu_pow5_inv_split{
+			0x0800000000000001ull, 0x0666666666666667ull, 0x051eb851eb851eb9ull, 0x04189374bc6a7efaull,
+			0x068db8bac710cb2aull, 0x053e2d6238da3c22ull, 0x0431bde82d7b634eull, 0x06b5fca6af2bd216ull,
+			0x055e63b88c230e78ull, 0x044b82fa09b5a52dull, 0x06df37f675ef6eaeull, 0x057f5ff85e592558ull,
+			0x0465e6604b7a8447ull, 0x0709709a125da071ull, 0x05a126e1a84ae6c1ull, 0x0480ebe7b9d58567ull,
+			0x0734aca5f6226f0bull, 0x05c3bd5191b525a3ull, 0x049c97747490eae9ull, 0x0760f253edb4ab0eull,
+			0x05e72843249088d8ull, 0x04b8ed0283a6d3e0ull, 0x078e480405d7b966ull, 0x060b6cd004ac9452ull,
+			0x04d5f0a66a23a9dbull, 0x07bcb43d769f762bull, 0x063090312bb2c4efull, 0x04f3a68dbc8f03f3ull,
+			0x07ec3daf94180651ull, 0x065697bfa9acd1daull, 0x051212ffbaf0a7e2ull
+		};
+
+		// ceil(log2(5^e)), or 1 for e = 0
+		[[nodiscard]] constexpr std::int32_t pow5_bits(std::int32_t e) {
+			return static_cast<std::int32_t>((static_cast<std::uint32_t>(e) * 1217359u) >> 19) + 1;
+		}
+		// floor(log10(2^e))
+		[[nodiscard]] constexpr std::int32_t log10_pow2(std::int32_t e) {
+			return static_cast<std::int32_t>((static_cast<std::uint32_t>(e) * 78913u) >> 18);
+		}
+		// floor(log10(5^e))
+		[[nodiscard]] constexpr std::int32_t log10_pow5(std::int32_t e) {
+			return static_cast<std::int32_t>((static_cast<std::uint32_t>(e) * 732923u) >> 20);
+		}
+
+		[[nodiscard]] constexpr bool is_multiple_of_pow5(std::uint32_t value, std::int32_t p) {
+			std::int32_t count = 0;
+			for (; value % 5 == 0; value /= 5) {
+				++count;
+			}
+			return count >= p;
+		}
+		[[nodiscard]] constexpr bool is_multiple_of_pow2(std::uint32_t value, std::int32_t p) {
+			return (value & ((1u << p) - 1u)) == 0;
+		}
+
+		// Computes (m * factor) >> shift, for shifts larger than 32
+		[[nodiscard]] constexpr std::uint32_t ryu_mul_shift(std::uint32_t m, std::uint64_t factor, std::int32_t shift) {
+			const std::uint64_t bits0 = static_cast<std::uint64_t>(m) * (factor & 0xFFFFFFFFu);
+			const std::uint64_t bits1 = static_cast<std::uint64_t>(m) * (factor >> 32);
+			return static_cast<std::uint32_t>(((bits0 >> 32) + bits1) >> (shift - 32));
+		}
+
+		// Shortest decimal representation of a float, as digits * 10^exponent
+		struct decimal_representation {
+			std::uint32_t digits = 0;
+			std::int32_t exponent = 0;
+		};
+
+		// Finds the shortest decimal number in the rounding interval of a finite non-zero float, and the one closest to
+		// the float if there are several
+		[[nodiscard]] constexpr decimal_representation to_shortest_decimal(float x) {
+			const std::uint32_t ieee_exponent = float_parts::get_exponent(x);
+			const std::uint32_t ieee_fraction = float_parts::get_fraction(x);
+
+			// The float is m2 * 2^e2, with two more bits so that the bounds of the rounding interval are integers
+			const std::int32_t e2 =
+				static_cast<std::int32_t>(std::max(ieee_exponent, 1u)) -
+				static_cast<std::int32_t>(float_parts::exponent_offset + float_parts::num_fraction_bits + 2);
+			const std::uint32_t m2 = ieee_exponent == 0 ? ieee_fraction : ieee_fraction | (1u << float_parts::num_fraction_bits);
+			// Ties between the bounds and the float round to even, so the bounds are inclusive if m2 is even
+			const bool accept_bounds = (m2 & 1u) == 0;
+
+			const std::uint32_t mv = 4 * m2;
+			// The lower bound is closer if the fraction is zero, except for the smallest normal exponent
+			const std::uint32_t mm_shift = ieee_fraction != 0 || ieee_exponent <= 1 ? 1u : 0u;
+			const std::uint32_t mp = 4 * m2 + 2;
+			const std::uint32_t mm = 4 * m2 - 1 - mm_shift;
+
+			// Compute the value and the bounds times 10^-e10, with e10 chosen so that the bounds are at least 10 apart
+			std::uint32_t vr = 0;
+			std::uint32_t vp = 0;
+			std::uint32_t vm = 0;
+			std::int32_t e10 = 0;
+			bool vm_is_trailing_zeros = false;
+			bool vr_is_trailing_zeros = false;
+			std::uint32_t last_removed_digit = 0;
+			if (e2 >= 0) {
+				const std::int32_t q = log10_pow2(e2);
+				e10 = q;
+				const std::int32_t k = ryu_pow5_inv_bit_count + pow5_bits(q) - 1;
+				const std::int32_t i = -e2 + q + k;
+				const std::uint64_t factor = ryu_pow5_inv_split[static_cast<std::size_t>(q)];
+				vr = ryu_mul_shift(mv, factor, i);
+				vp = ryu_mul_shift(mp, factor, i);
+				vm = ryu_mul_shift(mm, factor, i);
+				if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+					// The loop below removes at most one digit, which is computed here to round correctly
+					const std::int32_t l = ryu_pow5_inv_bit_count + pow5_bits(q - 1) - 1;
+					last_removed_digit = ryu_mul_shift(
+						mv, ryu_pow5_inv_split[static_cast<std::size_t>(q - 1)], -e2 + q - 1 + l
+					) % 10;
+				}
+				if (q <= 9) {
+					// Only one of mp, mv and mm can be a multiple of 5
+					if (mv % 5 == 0) {
+						vr_is_trailing_zeros = is_multiple_of_pow5(mv, q);
+					} else if (accept_bounds) {
+						vm_is_trailing_zeros = is_multiple_of_pow5(mm, q);
+					} else if (is_multiple_of_pow5(mp, q)) {
+						--vp;
+					}
+				}
+			} else {
+				const std::int32_t q = log10_pow5(-e2);
+				e10 = q + e2;
+				const std::int32_t i = -e2 - q;
+				const std::int32_t k = pow5_bits(i) - ryu_pow5_bit_count;
+				const std::int32_t j = q - k;
+				const std::uint64_t factor = ryu_pow5_split[static_cast<std::size_t>(i)];
+				vr = ryu_mul_shift(mv, factor, j);
+				vp = ryu_mul_shift(mp, factor, j);
+				vm = ryu_mul_shift(mm, factor, j);
+				if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+					const std::int32_t l = q - 1 - (pow5_bits(i + 1) - ryu_pow5_bit_count);
+					last_removed_digit = ryu_mul_shift(mv, ryu_pow5_split[static_cast<std::size_t>(i + 1)], l) % 10;
+				}
+				if (q <= 1) {
+					// mv has at least q trailing zero bits, and so does mp or mm depending on mm_shift
+					vr_is_trailing_zeros = true;
+					if (accept_bounds) {
+						vm_is_trailing_zeros = mm_shift == 1;
+					} else {
+						--vp;
+					}
+				} else if (q < 31) {
+					vr_is_trailing_zeros = is_multiple_of_pow2(mv, q - 1);
+				}
+			}
+
+			// Remove digits while the bounds still differ, then round the value to the remaining digits
+			std::int32_t removed = 0;
+			std::uint32_t output = 0;
+			if (vm_is_trailing_zeros || vr_is_trailing_zeros) {
+				// Rare case where exact ties and inclusive bounds need to be tracked
+				for (; vp / 10 > vm / 10; ++removed) {
+					vm_is_trailing_zeros = vm_is_trailing_zeros && vm % 10 == 0;
+					vr_is_trailing_zeros = vr_is_trailing_zeros && last_removed_digit == 0;
+					last_removed_digit = vr % 10;
+					vr /= 10;
+					vp /= 10;
+					vm /= 10;
+				}
+				if (vm_is_trailing_zeros) {
+					for (; vm % 10 == 0; ++removed) {
+						vr_is_trailing_zeros = vr_is_trailing_zeros && last_removed_digit == 0;
+						last_removed_digit = vr % 10;
+						vr /= 10;
+						vp /= 10;
+						vm /= 10;
+					}
+				}
+				if (vr_is_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) {
+					// Round ties to even
+					last_removed_digit = 4;
+				}
+				const bool round_up =
+					(vr == vm && (!accept_bounds || !vm_is_trailing_zeros)) || last_removed_digit >= 5;
+				output = vr + (round_up ? 1u : 0u);
+			} else {
+				for (; vp / 10 > vm / 10; ++removed) {
+					last_removed_digit = vr % 10;
+					vr /= 10;
+					vp /= 10;
+					vm /= 10;
+				}
+				output = vr + (vr == vm || last_removed_digit >= 5 ? 1u : 0u);
+			}
+			return decimal_representation{ output, e10 + removed };
+		}
+
+		// Pairs of decimal digits from 00 to 99
+		constexpr std::array<char, 200> decimal_digit_pairs = []() {
+			std::array<char, 200> result{};
+			for (std::size_t i = 0; i < 100; ++i) {
+				result[2 * i] = static_cast<char>('0' + i / 10);
+				result[2 * i + 1] = static_cast<char>('0' + i % 10);
+			}
+			return result;
+		}();
+
+		[[nodiscard]] constexpr std::uint32_t decimal_length(std::uint32_t value) {
+			std::uint32_t length = 1;
+			for (; value >= 10; value /= 10) {
+				++length;
+			}
+			return length;
+		}
+
+		[[nodiscard]] constexpr bool starts_with_ignore_case(const char *first, const char *last, std::string_view str) {
+			if (static_cast<std::size_t>(last - first) < str.size()) {
+				return false;
+			}
+			for (std::size_t i = 0; i < str.size(); ++i) {
+				const char c = first[i];
+				if ((c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c) != str[i]) {
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	// Maximum number of characters written by to_chars(), e.g. for -1.17549435e-38
+	constexpr std::size_t max_decimal_chars = 15;
+
+	// Writes the shortest decimal representation that parses back to the same float in scientific notation, in the
+	// same format as std::to_chars() with std::chars_format::scientific. If there are several shortest
+	// representations, the one closest to the float is used. Returns std::errc::value_too_large and last if the buffer
+	// is too small
+	constexpr std::to_chars_result to_chars(char *first, char *last, float x) {
+		const bool sign = float_parts::get_sign(x);
+		const auto write_string = [&](std::string_view str) -> std::to_chars_result {
+			if (static_cast<std::size_t>(last - first) < str.size() + (sign ? 1 : 0)) {
+				return { last, std::errc::value_too_large };
+			}
+			if (sign) {
+				*first++ = '-';
+			}
+			return { std::copy(str.begin(), str.end(), first), std::errc() };
+		};
+		if (is_nan(x)) {
+			return write_string("nan");
+		}
+		if (is_inf(x)) {
+			return write_string("inf");
+		}
+		if (is_zero(x)) {
+			return write_string("0e+00");
+		}
+
+		const _details::decimal_representation decimal = _details::to_shortest_decimal(x);
+		const std::uint32_t length = _details::decimal_length(decimal.digits);
+		const std::int32_t exponent = decimal.exponent + static_cast<std::int32_t>(length) - 1;
+		// The exponent of a float always has two digits
+		const std::size_t total_length = (sign ? 1 : 0) + length + (length > 1 ? 1 : 0) + 4;
+		if (static_cast<std::size_t>(last - first) < total_length) {
+			return { last, std::errc::value_too_large };
+		}
+
+		if (sign) {
+			*first++ = '-';
+		}
+		// Write the digits from the back, leaving space for the decimal point after the first one
+		char *digits_end = first + length + (length > 1 ? 1 : 0);
+		char *out = digits_end;
+		std::uint32_t digits = decimal.digits;
+		for (std::uint32_t remaining = length; remaining > 1; ) {
+			if (remaining > 2) {
+				const std::uint32_t pair = digits % 100;
+				digits /= 100;
+				*--out = _details::decimal_digit_pairs[2 * pair + 1];
+				*--out = _details::decimal_digit_pairs[2 * pair];
+				remaining -= 2;
+			} else {
+				*--out = static_cast<char>('0' + digits % 10);
+				digits /= 10;
+				--remaining;
+			}
+		}
+		if (length > 1) {
+			*--out = '.';
+		}
+		*--out = static_cast<char>('0' + digits);
+
+		const std::uint32_t exponent_abs = static_cast<std::uint32_t>(exponent < 0 ? -exponent : exponent);
+		digits_end[0] = 'e';
+		digits_end[1] = exponent < 0 ? '-' : '+';
+		digits_end[2] = _details::decimal_digit_pairs[2 * exponent_abs];
+		digits_end[3] = _details::decimal_digit_pairs[2 * exponent_abs + 1];
+		return { digits_end + 4, std::errc() };
+	}
+
+	// Returns the result of to_chars() as a string
+	[[nodiscard]] inline std::string to_string(float x) {
+		std::array<char, max_decimal_chars> buffer;
+		const std::to_chars_result result = to_chars(buffer.data(), buffer.data() + buffer.size(), x);
+		return std::string(buffer.data(), result.ptr);
+	}
+
+
+	// Correctly rounded parsing
+	namespace _details {
+		// Normalized 64-bit significands of powers of ten, rounded down, and their binary exponents, so that
+		// 10^q ~= significand * 2^exponent. Decimal exponents outside of this range always overflow or underflow when
+		// combined with at most 19 significant digits
+		constexpr std::int32_t min_decimal_exponent = -65;
+		constexpr std::int32_t max_decimal_exponent = 38;
+		// Powers of ten up to this one have exact significands
+		constexpr std::int32_t max_exact_decimal_exponent = 27;
+		struct power_of_ten {
+			std::uint64_t significand = 0;
+			std::int32_t exponent = 0;
+
+			[[nodiscard]] friend constexpr bool operator==(const power_of_ten&, const power_of_ten&) = default;
+		};
+		using powers_of_ten_table = std::array<power_of_ten, max_decimal_exponent - min_decimal_exponent + 1>;
+		// Written out below like the Ryu tables, and checked against this generator by exec_decimal
+		[[nodiscard]] constexpr powers_of_ten_table generate_powers_of_ten() {
+			powers_of_ten_table result{};
+			for (std::int32_t q = min_decimal_exponent; q <= max_decimal_exponent; ++q) {
+				power_of_ten &entry = result[static_cast<std::size_t>(q - min_decimal_exponent)];
+				if (q >= 0) {
+					const decimal_bignum value = power_of_ten_bignum(static_cast<std::uint32_t>(q));
+					entry.exponent = static_cast<std::int32_t>(value.bit_width()) - 64;
+					entry.significand = value.get_bits(entry.exponent);
+				} else {
+					// floor(2^j / 10^p) = floor(2^(j - p) / 5^p), where repeated division by 5 gives the same result as
+					// dividing by 5^p
+					const auto p = static_cast<std::uint32_t>(-q);
+					const std::uint32_t j = 63 + power_of_ten_bignum(p).bit_width();
+					decimal_bignum value = decimal_bignum::power_of_two(j - p);
+					for (std::uint32_t i = 0; i < p; ++i) {
+						value.divide(5);
+					}
+					entry.significand = value.get_bits(0);
+					entry.exponent = -static_cast<std::int32_t>(j);
+				}
+			}
+			return result;
+		}
+		constexpr powers_of_ten_table powers_of_ten{ {
+			{ 0x86ccbb52ea94baeaull, -279 }, { 0xa87fea27a539e9a5ull, -276 }, { 0xd29fe4b18e88640eull, -273 },
+			{ 0x83a3eeeef9153e89ull, -269 }, { 0xa48ceaaab75a8e2bull, -266 }, { 0xcdb02555653131b6ull, -263 },
+			{ 0x808e17555f3ebf11ull, -259 }, { 0xa0b19d2ab70e6ed6ull, -256 }, { 0xc8de047564d20a8bull, -253 },
+			{ 0xfb158592be068d2eull, -250 }, { 0x9ced737bb6c4183dull, -246 }, { 0xc428d05aa4751e4cull, -243 },
+			{ 0xf53304714d9265dfull, -240 }, { 0x993fe2c6d07b7fabull, -236 }, { 0xbf8fdb78849a5f96ull, -233 },
+			{ 0xef73d256a5c0f77cull, -230 }, { 0x95a8637627989aadull, -226 }, { 0xbb127c53b17ec159ull, -223 },
+			{ 0xe9d71b689dde71afull, -220 }, { 0x9226712162ab070dull, -216 }, { 0xb6b00d69bb55c8d1ull, -213 },
+			{ 0xe45c10c42a2b3b05ull, -210 }, { 0x8eb98a7a9a5b04e3ull, -206 }, { 0xb267ed1940f1c61cull, -203 },
+			{ 0xdf01e85f912e37a3ull, -200 }, { 0x8b61313bbabce2c6ull, -196 }, { 0xae397d8aa96c1b77ull, -193 },
+			{ 0xd9c7dced53c72255ull, -190 }, { 0x881cea14545c7575ull, -186 }, { 0xaa242499697392d2ull, -183 },
+			{ 0xd4ad2dbfc3d07787ull, -180 }, { 0x84ec3c97da624ab4ull, -176 }, { 0xa6274bbdd0fadd61ull, -173 },
+			{ 0xcfb11ead453994baull, -170 }, { 0x81ceb32c4b43fcf4ull, -166 }, { 0xa2425ff75e14fc31ull, -163 },
+			{ 0xcad2f7f5359a3b3eull, -160 }, { 0xfd87b5f28300ca0dull, -157 }, { 0x9e74d1b791e07e48ull, -153 },
+			{ 0xc612062576589ddaull, -150 }, { 0xf79687aed3eec551ull, -147 }, { 0x9abe14cd44753b52ull, -143 },
+			{ 0xc16d9a0095928a27ull, -140 }, { 0xf1c90080baf72cb1ull, -137 }, { 0x971da05074da7beeull, -133 },
+			{ 0xbce5086492111aeaull, -130 }, { 0xec1e4a7db69561a5ull, -127 }, { 0x9392ee8e921d5d07ull, -123 },
+			{ 0xb877aa3236a4b449ull, -120 }, { 0xe69594bec44de15bull, -117 }, { 0x901d7cf73ab0acd9ull, -113 },
+			{ 0xb424dc35095cd80full, -110 }, { 0xe12e13424bb40e13ull, -107 }, { 0x8cbccc096f5088cbull, -103 },
+			{ 0xafebff0bcb24aafeull, -100 }, { 0xdbe6fecebdedd5beull, -97 }, { 0x89705f4136b4a597ull, -93 },
+			{ 0xabcc77118461cefcull, -90 }, { 0xd6bf94d5e57a42bcull, -87 }, { 0x8637bd05af6c69b5ull, -83 },
+			{ 0xa7c5ac471b478423ull, -80 }, { 0xd1b71758e219652bull, -77 }, { 0x83126e978d4fdf3bull, -73 },
+			{ 0xa3d70a3d70a3d70aull, -70 }, { 0xccccccccccccccccull, -67 }, { 0x8000000000000000ull, -63 },
+			{ 0xa000000000000000ull, -60 }, { 0xc800000000000000ull, -57 }, { 0xfa00000000000000ull, -54 },
+			{ 0x9c40000000000000ull, -50 }, { 0xc350000000000000ull, -47 }, { 0xf424000000000000ull, -44 },
+			{ 0x9896800000000000ull, -40 }, { 0xbebc200000000000ull, -37 }, { 0xee6b280000000000ull, -34 },
+			{ 0x9502f90000000000ull, -30 }, { 0xba43b74000000000ull, -27 }, { 0xe8d4a51000000000ull, -24 },
+			{ 0x9184e72a00000000ull, -20 }, { 0xb5e620f480000000ull, -17 }, { 0xe35fa931a0000000ull, -14 },
+			{ 0x8e1bc9bf04000000ull, -10 }, { 0xb1a2bc2ec5000000ull, -7 }, { 0xde0b6b3a76400000ull, -4 },
+			{ 0x8ac7230489e80000ull, 0 }, { 0xad78ebc5ac620000ull, 3 }, { 0xd8d726b7177a8000ull, 6 },
+			{ 0x878678326eac9000ull, 10 }, { 0xa968163f0a57b400ull, 13 }, { 0xd3c21bcecceda100ull, 16 },
+			{ 0x84595161401484a0ull, 20 }, { 0xa56fa5b99019a5c8ull, 23 }, { 0xcecb8f27f4200f3aull, 26 },
+			{ 0x813f3978f8940984ull, 30 }, { 0xa18f07d736b90be5ull, 33 }, { 0xc9f2c9cd04674edeull, 36 },
+			{ 0xfc6f7c4045812296ull, 39 }, { 0x9dc5ada82b70b59dull, 43 }, { 0xc5371912364ce305ull, 46 },
+			{ 0xf684df56c3e01bc6ull, 49 }, { 0x9a130b963a6c115cull, 53 }, { 0xc097ce7bc90715b3ull, 56 },
+			{ 0xf0bdc21abb48db20ull, 59 }, { 0x96769950b50d88f4ull, 63 }
+		} };
+		// Powers of five that fit in 64 bits
+		constexpr std::array<std::uint64_t, max_exact_decimal_exponent + 1> powers_of_five = []() {
+			std::array<std::uint64_t, max_exact_decimal_exponent + 1> result{};
+			std::uint64_t value = 1;
+			for (std::uint64_t &entry : result) {
+				entry = value;
+				value *= 5;
+			}
+			return result;
+		}();
+
+		// Significant digits beyond this are only kept as a sticky bit by the exact path. Midpoints between floats
+		// and floats themselves have at most 114 significant digits, so no rounding boundary can lie between a
+		// decimal number and its truncation
+		constexpr std::uint32_t max_exact_digits = 120;
+
+		// Rounds (significand + f) * 2^exponent, where f is in [0, 1) and is non-zero if sticky is set. Sets
+		// out_of_range if the magnitude overflows, or if the non-zero value rounds to zero
+		[[nodiscard]] constexpr float round_significand(
+			rounding_mode rounding, bool sign, std::uint64_t significand, std::int32_t exponent, bool sticky,
+			bool &out_of_range
+		) {
+			const auto zeros = static_cast<std::int32_t>(std::countl_zero(significand));
+			significand <<= zeros;
+			// Offset exponent of the highest bit
+			const std::int32_t top_exponent = exponent - zeros + 63;
+			const std::int32_t biased_exponent = top_exponent + static_cast<std::int32_t>(float_parts::exponent_offset);
+			if (biased_exponent >= static_cast<std::int32_t>((1u << float_parts::num_exponent_bits) - 1)) {
+				out_of_range = true;
+				return round_result(rounding, sign, (1u << float_parts::num_exponent_bits) - 1, 0, 0, true);
+			}
+
+			constexpr std::uint32_t num_truncated_bits = 63 - float_parts::num_fraction_bits;
+			auto rf = static_cast<std::uint32_t>(significand >> num_truncated_bits);
+			std::uint32_t truncated_bits =
+				static_cast<std::uint32_t>(significand >> (num_truncated_bits - 32)) |
+				(sticky || (significand & ((1ull << (num_truncated_bits - 32)) - 1)) != 0 ? 1u : 0u);
+			std::uint32_t re = static_cast<std::uint32_t>(biased_exponent);
+			if (biased_exponent <= 0) {
+				denormalize(rf, truncated_bits, static_cast<std::uint32_t>(1 - std::max(biased_exponent, -64)));
+				re = 0;
+			}
+			const float result = round_result(rounding, sign, re, rf, truncated_bits, false);
+			out_of_range = is_inf(result) || is_zero(result);
+			return result;
+		}
+
+		// Computes the exact value of the decimal number, with at most max_exact_digits significant digits and the
+		// rest kept as a sticky bit. The mantissa contains digits and at most one decimal point
+		[[nodiscard]] constexpr float parse_decimal_exact(
+			rounding_mode rounding, bool sign, const char *mantissa_first, const char *mantissa_last,
+			std::int64_t exponent, bool &out_of_range
+		) {
+			decimal_bignum value;
+			std::uint32_t num_digits = 0;
+			bool sticky = false;
+			bool fraction = false;
+			// Digits are accumulated in groups of up to 9 before they are added to the big number
+			std::uint32_t group = 0;
+			std::uint32_t group_scale = 1;
+			for (const char *cur = mantissa_first; cur != mantissa_last; ++cur) {
+				if (*cur == '.') {
+					fraction = true;
+					continue;
+				}
+				const auto digit = static_cast<std::uint32_t>(*cur - '0');
+				if (num_digits == 0 && digit == 0) {
+					// Leading zeros
+					exponent -= fraction ? 1 : 0;
+				} else if (num_digits < max_exact_digits) {
+					group = group * 10 + digit;
+					group_scale *= 10;
+					if (group_scale == 1000000000u) {
+						value.multiply_add(group_scale, group);
+						group = 0;
+						group_scale = 1;
+					}
+					++num_digits;
+					exponent -= fraction ? 1 : 0;
+				} else {
+					sticky = sticky || digit != 0;
+					exponent += fraction ? 0 : 1;
+				}
+			}
+			value.multiply_add(group_scale, group);
+
+			// Handle values that are out of range, for which the big number would not be large enough
+			const std::int64_t leading_exponent = exponent + num_digits - 1;
+			if (leading_exponent > max_decimal_exponent) {
+				return round_significand(rounding, sign, 1, 1024, true, out_of_range);
+			}
+			// Values below 10^-46 are less than half of the smallest subnormal number
+			if (leading_exponent < -46) {
+				return round_significand(rounding, sign, 1, -1024, true, out_of_range);
+			}
+
+			if (exponent >= 0) {
+				for (std::int64_t i = 0; i < exponent; ++i) {
+					value.multiply_add(10, 0);
+				}
+				const std::int32_t shift = static_cast<std::int32_t>(value.bit_width()) - 64;
+				return round_significand(
+					rounding, sign, value.get_bits(shift), shift, sticky || value.any_bits_below(shift), out_of_range
+				);
+			}
+
+			// Divide by 10^-exponent, with the numerator scaled so that the quotient has 63 or 64 bits
+			decimal_bignum divisor = power_of_ten_bignum(static_cast<std::uint32_t>(-exponent));
+			const std::int32_t shift =
+				63 - static_cast<std::int32_t>(value.bit_width()) + static_cast<std::int32_t>(divisor.bit_width());
+			if (shift >= 0) {
+				value.shift_left(static_cast<std::uint32_t>(shift));
+			} else {
+				divisor.shift_left(static_cast<std::uint32_t>(-shift));
+			}
+			// Long division, starting from the part of the numerator that is known to be smaller than the divisor
+			decimal_bignum remainder = value;
+			remainder.shift_right(64);
+			std::uint64_t quotient = 0;
+			for (std::uint32_t i = 64; i > 0; --i) {
+				remainder.shift_left(1);
+				remainder.limbs[0] |= value.get_bit(i - 1) ? 1u : 0u;
+				quotient <<= 1;
+				if (!(remainder < divisor)) {
+					remainder.subtract(divisor);
+					quotient |= 1u;
+				}
+			}
+			return round_significand(
+				rounding, sign, quotient, -shift, sticky || remainder.bit_width() != 0, out_of_range
+			);
+		}
+	}
+
+	// Parses a decimal number in the format accepted by std::from_chars() with std::chars_format::general: an optional
+	// minus sign, digits with an optional decimal point, and an optional exponent, or inf, infinity, nan, or
+	// nan(chars), ignoring case. The value is correctly rounded using the given rounding mode, for any number of
+	// digits. Unlike std::from_chars(), values that are out of range are still stored: they are rounded to zero, the
+	// largest finite value, or infinity according to the rounding mode, and std::errc::result_out_of_range is
+	// returned
+	template <rounding_mode Rounding = rounding_mode::nearest_tie_to_even> constexpr std::from_chars_result from_chars(
+		const char *first, const char *last, float &value
+	) {
+		static_assert(
+			Rounding != rounding_mode::stochastic,
+			"Digits beyond the significand are only kept as a sticky bit, which is not enough for stochastic rounding"
+		);
+		const rounding_mode rounding = Rounding == rounding_mode::system ? get_system_rounding_mode() : Rounding;
+
+		const char *cur = first;
+		const bool sign = cur != last && *cur == '-';
+		cur += sign ? 1 : 0;
+		const bool special = cur != last && (*cur < '0' || *cur > '9') && *cur != '.';
+		if (special && _details::starts_with_ignore_case(cur, last, "inf")) {
+			cur += _details::starts_with_ignore_case(cur, last, "infinity") ? 8 : 3;
+			value = std::bit_cast<float>(float_parts::assemble_bits(sign, (1u << float_parts::num_exponent_bits) - 1, 0));
+			return { cur, std::errc() };
+		}
+		if (special && _details::starts_with_ignore_case(cur, last, "nan")) {
+			cur += 3;
+			if (cur != last && *cur == '(') {
+				const char *end = cur + 1;
+				for (; end != last; ++end) {
+					const char c = *end;
+					if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')) {
+						break;
+					}
+				}
+				if (end != last && *end == ')') {
+					cur = end + 1;
+				}
+			}
+			value = std::bit_cast<float>(float_parts::assemble_bits(
+				sign, (1u << float_parts::num_exponent_bits) - 1, 1u << (float_parts::num_fraction_bits - 1)
+			));
+			return { cur, std::errc() };
+		}
+
+		// Keep the first 19 significant digits, which always fit in 64 bits, and record whether any digit after them
+		// is non-zero
+		constexpr std::uint32_t max_fast_digits = 19;
+		const char *mantissa_first = cur;
+		std::uint64_t digits = 0;
+		std::uint32_t num_digits = 0;
+		std::int64_t exponent = 0;
+		bool truncated = false;
+		// Digits after the decimal point decrease the exponent when they are kept, and digits before it increase the
+		// exponent when they are dropped
+		const auto parse_digits = [&](std::int64_t kept_exponent, std::int64_t dropped_exponent) {
+			const char *digits_first = cur;
+			for (; cur != last && *cur >= '0' && *cur <= '9'; ++cur) {
+				const auto digit = static_cast<std::uint32_t>(*cur - '0');
+				if (num_digits < max_fast_digits) {
+					digits = digits * 10 + digit;
+					num_digits += digits != 0 ? 1 : 0;
+					exponent += kept_exponent;
+				} else {
+					truncated = truncated || digit != 0;
+					exponent += dropped_exponent;
+				}
+			}
+			return cur != digits_first;
+		};
+		bool any_digits = parse_digits(0, 1);
+		if (cur != last && *cur == '.') {
+			++cur;
+			any_digits = parse_digits(-1, 0) || any_digits;
+		}
+		if (!any_digits) {
+			return { first, std::errc::invalid_argument };
+		}
+		const char *mantissa_last = cur;
+
+		std::int64_t explicit_exponent = 0;
+		if (cur != last && (*cur == 'e' || *cur == 'E')) {
+			const char *exponent_cur = cur + 1;
+			const bool exponent_sign = exponent_cur != last && *exponent_cur == '-';
+			exponent_cur += exponent_cur != last && (*exponent_cur == '-' || *exponent_cur == '+') ? 1 : 0;
+			// The exponent is only consumed if it has at least one digit
+			if (exponent_cur != last && *exponent_cur >= '0' && *exponent_cur <= '9') {
+				for (; exponent_cur != last && *exponent_cur >= '0' && *exponent_cur <= '9'; ++exponent_cur) {
+					// Clamped so that it does not overflow; any exponent this large is out of range
+					explicit_exponent = std::min<std::int64_t>(explicit_exponent * 10 + (*exponent_cur - '0'), 1 << 30);
+				}
+				explicit_exponent = exponent_sign ? -explicit_exponent : explicit_exponent;
+				cur = exponent_cur;
+			}
+		}
+		exponent += explicit_exponent;
+
+		bool out_of_range = false;
+		if (digits == 0) {
+			value = sign ? -0.0f : 0.0f;
+		} else if (exponent > _details::max_decimal_exponent) {
+			value = _details::round_significand(rounding, sign, 1, 1024, true, out_of_range);
+		} else if (exponent < _details::min_decimal_exponent) {
+			value = _details::round_significand(rounding, sign, 1, -1024, true, out_of_range);
+		} else {
+			// Multiply the normalized digits by the power of ten. The product is exact if the power of ten is exact and
+			// no digits have been truncated; otherwise, the exact value lies in [product, product + 2^70)
+			const _details::power_of_ten power =
+				_details::powers_of_ten[static_cast<std::size_t>(exponent - _details::min_decimal_exponent)];
+			const auto zeros = static_cast<std::int32_t>(std::countl_zero(digits));
+			std::uint64_t low = 0;
+			std::uint64_t high = _details::multiply_wide(digits << zeros, power.significand, low);
+			std::int32_t high_exponent = power.exponent - zeros + 64;
+			if ((high >> 63) == 0) {
+				high = (high << 1) | (low >> 63);
+				low <<= 1;
+				--high_exponent;
+			}
+
+			if (!truncated && exponent >= 0 && exponent <= _details::max_exact_decimal_exponent) {
+				value = _details::round_significand(rounding, sign, high, high_exponent, low != 0, out_of_range);
+			} else {
+				// The rounding is decided by the high half alone if the error bound cannot move the value across the
+				// float it rounds down to, or across the midpoint. Values below the smallest subnormal are left to the
+				// exact path
+				const std::int32_t top_exponent = high_exponent + 63;
+				const std::int32_t result_bits = std::min<std::int32_t>(
+					float_parts::num_fraction_bits + 1,
+					top_exponent + static_cast<std::int32_t>(float_parts::exponent_offset + float_parts::num_fraction_bits)
+				);
+				bool decided = false;
+				if (result_bits > 0) {
+					const std::uint64_t remainder_bits = 64 - static_cast<std::uint64_t>(result_bits);
+					const std::uint64_t remainder = high & ((1ull << remainder_bits) - 1);
+					const std::uint64_t half = 1ull << (remainder_bits - 1);
+					constexpr std::uint64_t error = 1ull << (70 - 64);
+					decided =
+						(remainder > 0 && remainder + error + 1 <= half) ||
+						(remainder > half && remainder + error + 1 <= 2 * half);
+				}
+				const auto negative_exponent = static_cast<std::size_t>(-exponent);
+				if (decided) {
+					value = _details::round_significand(rounding, sign, high, high_exponent, true, out_of_range);
+				} else if (
+					!truncated && exponent < 0 && negative_exponent <= _details::max_exact_decimal_exponent &&
+					digits % _details::powers_of_five[negative_exponent] == 0
+				) {
+					// The value is a multiple of a power of two, such as a float or a midpoint between floats. Such
+					// values are close to rounding boundaries, but can be computed exactly
+					value = _details::round_significand(
+						rounding, sign, digits / _details::powers_of_five[negative_exponent],
+						static_cast<std::int32_t>(exponent), false, out_of_range
+					);
+				} else {
+					value = _details::parse_decimal_exact(
+						rounding, sign, mantissa_first, mantissa_last, explicit_exponent, out_of_range
+					);
+				}
+			}
+		}
+		return { cur, out_of_range ? std::errc::result_out_of_range : std::errc() };
+	}
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+
+// Batch kernels are compiled for several instruction sets side by side, and one of them is chosen at runtime based on
+// the features of the CPU. This is only supported by GCC and Clang on x86; everywhere else, only the scalar variant,
+// compiled for the baseline architecture of the build, is used
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	define FLOAT_UTILS_SIMD_DISPATCH
+// Inline all calls so that the whole kernel is compiled for the target instruction set
+#	define FLOAT_UTILS_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,fma,lzcnt,popcnt"), flatten))
+#	define FLOAT_UTILS_TARGET_AVX512 \
+		__attribute__((target("avx512f,avx512vl,avx512bw,avx512dq,avx2,bmi,bmi2,fma,lzcnt,popcnt"), flatten))
+#else
+#	define FLOAT_UTILS_TARGET_AVX2
+#	define FLOAT_UTILS_TARGET_AVX512
+#endif
+
+namespace float_utils {
+	// Instruction sets that batch kernels are compiled for
+	enum class simd_level {
+		scalar, // The baseline architecture of the build, which may still be vectorized by the compiler
+		avx2,
+		avx512,
+
+		count
+	};
+	constexpr std::size_t num_simd_levels = static_cast<std::size_t>(simd_level::count);
+
+	[[nodiscard]] constexpr std::string_view get_simd_level_name(simd_level level) {
+		constexpr std::array<std::string_view, num_simd_levels> names{ "scalar", "avx2", "avx512" };
+		return names[static_cast<std::size_t>(level)];
+	}
+	[[nodiscard]] constexpr std::optional<simd_level> parse_simd_level(std::string_view name) {
+		for (std::size_t i = 0; i < num_simd_levels; ++i) {
+			if (get_simd_level_name(static_cast<simd_level>(i)) == name) {
+				return static_cast<simd_level>(i);
+			}
+		}
+		return std::nullopt;
+	}
+
+	// Returns the highest level supported by the CPU and the operating system. Detected once using CPUID
+	[[nodiscard]] inline simd_level get_supported_simd_level() {
+		static const simd_level level = []() {
+#ifdef FLOAT_UTILS_SIMD_DISPATCH
+			__builtin_cpu_init();
+			// Every feature enabled by the target attributes is checked. lzcnt is reported by CPUID as ABM
+			const bool avx2 =
+				__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2") &&
+				__builtin_cpu_supports("fma") && __builtin_cpu_supports("abm") && __builtin_cpu_supports("popcnt");
+			const bool avx512 =
+				avx2 &&
+				__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+				__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq");
+			return avx512 ? simd_level::avx512 : avx2 ? simd_level::avx2 : simd_level::scalar;
+#else
+			return simd_level::scalar;
+#endif
+		}();
+		return level;
+	}
+
+	namespace _details {
+		// The level used by batch kernels. Initialized to the supported level, or to the level in the FLOAT_UTILS_SIMD
+		// environment variable if it is set and supported
+		[[nodiscard]] inline std::atomic<simd_level> &get_active_simd_level() {
+			static std::atomic<simd_level> level = []() {
+				const simd_level supported = get_supported_simd_level();
+				if (const char *env = std::getenv("FLOAT_UTILS_SIMD")) {
+					const std::optional<simd_level> requested = parse_simd_level(env);
+					if (requested && requested.value() <= supported) {
+						return requested.value();
+					}
+				}
+				return supported;
+			}();
+			return level;
+		}
+	}
+
+	[[nodiscard]] inline simd_level get_simd_level() {
+		return _details::get_active_simd_level().load(std::memory_order_relaxed);
+	}
+	// Overrides the level used by batch kernels, mainly for testing. Returns false if the level is not supported
+	inline bool set_simd_level(simd_level level) {
+		if (level > get_supported_simd_level()) {
+			return false;
+		}
+		_details::get_active_simd_level().store(level, std::memory_order_relaxed);
+		return true;
+	}
+
+	namespace _details {
+		// Kernels are stateless function objects. Each of these wrappers compiles the kernel for one instruction set
+		template <typename Kernel, typename ...Args> decltype(auto) run_kernel_scalar(Args ...args) {
+			return Kernel{}(args...);
+		}
+		template <typename Kernel, typename ...Args> FLOAT_UTILS_TARGET_AVX2 decltype(auto) run_kernel_avx2(
+			Args ...args
+		) {
+			return Kernel{}(args...);
+		}
+		template <typename Kernel, typename ...Args> FLOAT_UTILS_TARGET_AVX512 decltype(auto) run_kernel_avx512(
+			Args ...args
+		) {
+			return Kernel{}(args...);
+		}
+
+		// Runs the variant of the kernel for the active level
+		template <typename Kernel, typename ...Args> decltype(auto) dispatch_kernel(Args ...args) {
+			switch (get_simd_level()) {
+			case simd_level::avx512:
+				return run_kernel_avx512<Kernel>(args...);
+			case simd_level::avx2:
+				return run_kernel_avx2<Kernel>(args...);
+			case simd_level::scalar:
+				[[fallthrough]];
+			case simd_level::count:
+				break;
+			}
+			return run_kernel_scalar<Kernel>(args...);
+		}
+	}
+}
@@ -2,12 +2,91 @@
 
 #include <algorithm>
 #include <bit>
+#include <limits>
 
+#include "category.h"
 #include "float_parts.h"
 #include "utils.h"
 
 namespace float_utils {
-	template <rounding_mode Rounding> float div(float x, float y) {
+	namespace _details {
+		// Divides two numbers given their offset exponents and normalized fractions with the implicit bit set
+		template <rounding_mode Rounding, typename Instrumentation> constexpr float div_normalized(
+			bool rp, std::int32_t xe, std::uint64_t xfrac, std::int32_t ye, std::uint64_t yfrac
+		) {
+			const std::uint64_t xfrac_align = xfrac << (64 - (float_parts::num_fraction_bits + 1));
+			const std::uint64_t rfrac_raw = xfrac_align / yfrac;
+			const std::uint64_t rrem = xfrac_align - rfrac_raw * yfrac;
+			if (rrem > 0) {
+				Instrumentation::hit(operator_path::div_remainder);
+			}
+
+			const std::uint32_t rfzeros = std::countl_zero(rfrac_raw);
+			const std::uint32_t rfshiftr_bits = 64 - (float_parts::num_fraction_bits + 1) - rfzeros;
+			// Set the lowest bit to 1 to indicate if there's a remainder
+			auto truncated_bits = static_cast<std::uint32_t>((rfrac_raw << (32u - rfshiftr_bits)) | (rrem > 0 ? 1 : 0));
+
+			const std::int32_t re_raw =
+				(xe - ye + float_parts::num_fraction_bits - rfzeros) +
+				static_cast<std::int32_t>(float_parts::exponent_offset);
+
+			auto re = static_cast<std::uint32_t>(std::clamp<std::int32_t>(
+				re_raw, 0, (1 << float_parts::num_exponent_bits) - 1
+			));
+			auto rf = static_cast<std::uint32_t>(rfrac_raw >> rfshiftr_bits);
+			if (re_raw <= 0) [[unlikely]] {
+				// The result is subnormal
+				Instrumentation::hit(operator_path::div_subnormal_result);
+				denormalize(rf, truncated_bits, static_cast<std::uint32_t>(1 - re_raw));
+			}
+			const bool is_inf = re_raw >= (1 << float_parts::num_exponent_bits) - 1;
+
+			// Round and return
+			const rounding_mode rounding = Rounding == rounding_mode::system ? get_system_rounding_mode() : Rounding;
+			return round_result<Instrumentation>(rounding, rp, re, rf, truncated_bits, is_inf);
+		}
+
+		// Handles the case where at least one of x and y is zero or subnormal
+		template <rounding_mode Rounding, typename Instrumentation> constexpr float div_subnormal(float x, float y) {
+			const bool rp = float_parts::get_sign(x) != float_parts::get_sign(y);
+
+			if (is_zero(y)) {
+				if (is_zero(x)) {
+					return std::numeric_limits<float>::quiet_NaN();
+				}
+				constexpr float inf = std::numeric_limits<float>::infinity();
+				return rp ? -inf : inf;
+			}
+			if (is_zero(x)) {
+				return rp ? -0.0f : 0.0f;
+			}
+
+			std::int32_t xe = float_parts::get_offset_exponent(x);
+			std::int32_t ye = float_parts::get_offset_exponent(y);
+			std::uint32_t xf = float_parts::get_fraction(x);
+			std::uint32_t yf = float_parts::get_fraction(y);
+			if (float_parts::get_exponent(x) == 0) {
+				xe = normalize_subnormal(xf);
+			} else {
+				xf |= 1u << float_parts::num_fraction_bits;
+			}
+			if (float_parts::get_exponent(y) == 0) {
+				ye = normalize_subnormal(yf);
+			} else {
+				yf |= 1u << float_parts::num_fraction_bits;
+			}
+			return div_normalized<Rounding, Instrumentation>(rp, xe, xf, ye, yf);
+		}
+	}
+
+	template <
+		rounding_mode Rounding, typename Instrumentation = no_instrumentation
+	> constexpr float div(float x, float y) {
+		if (float_parts::get_exponent(x) == 0 || float_parts::get_exponent(y) == 0) [[unlikely]] {
+			Instrumentation::hit(operator_path::div_special_operand);
+			return _details::div_subnormal<Rounding, Instrumentation>(x, y);
+		}
+
 		const auto xfrac = static_cast<std::uint64_t>(
 			float_parts::get_fraction(x) | (1u << float_parts::num_fraction_bits)
 		);
@@ -16,29 +95,8 @@ namespace float_utils {
 		);
 		const std::int32_t xe = float_parts::get_offset_exponent(x);
 		const std::int32_t ye = float_parts::get_offset_exponent(y);
-
-		const std::uint64_t xfrac_align = xfrac << (64 - (float_parts::num_fraction_bits + 1));
-		const std::uint64_t rfrac_raw = xfrac_align / yfrac;
-		const std::uint64_t rrem = xfrac_align - rfrac_raw * yfrac;
-
-		const std::uint32_t rfzeros = std::countl_zero(rfrac_raw);
-		const std::uint32_t rfshiftr_bits = 64 - (float_parts::num_fraction_bits + 1) - rfzeros;
-		// Set the lowest bit to 1 to indicate if there's a remainder
-		const auto truncated_bits = static_cast<std::uint32_t>((rfrac_raw << (32u - rfshiftr_bits)) | (rrem > 0 ? 1 : 0));
-
-		const std::int32_t re_raw =
-			(xe - ye + float_parts::num_fraction_bits - rfzeros) +
-			static_cast<std::int32_t>(float_parts::exponent_offset);
-
-		const bool is_inf = re_raw >= (1 << float_parts::num_exponent_bits) - 1;
 		const bool rp = float_parts::get_sign(x) != float_parts::get_sign(y);
-		const auto re = static_cast<std::uint32_t>(std::clamp<std::int32_t>(
-			re_raw, 0, (1 << float_parts::num_exponent_bits) - 1
-		));
-		const auto rf = static_cast<std::uint32_t>(rfrac_raw >> rfshiftr_bits);
-
-		// Round and return
-		const rounding_mode rounding = Rounding == rounding_mode::system ? get_system_rounding_mode() : Rounding;
-		return round_result(rounding, rp, re, rf, truncated_bits, is_inf);
+
+		return _details::div_normalized<Rounding, Instrumentation>(rp, xe, xfrac, ye, yfrac);
 	}
 }
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "add.h"
+#include "dispatch.h"
+#include "float_parts.h"
+#include "mul.h"
+#include "utils.h"
+
+namespace float_utils {
+	namespace _details {
+		// Size of the register tile computed by one call of the micro kernel
+		constexpr std::size_t gemm_tile_rows = 4;
+		constexpr std::size_t gemm_tile_cols = 16;
+		// Size of the blocks of c computed by one thread, and of the slices of k that are packed together. Packed
+		// slices of a and b take 64 KB each, and stay in L2 while all tiles of the block are computed
+		constexpr std::size_t gemm_block_rows = 64;
+		constexpr std::size_t gemm_block_cols = 64;
+		constexpr std::size_t gemm_block_depth = 256;
+
+		// The micro kernel computes every step of all columns of a tile row with the branch-free functions below, which
+		// the compiler vectorizes. They only handle normal operands and results, and zeros, and flag all other lanes,
+		// which are then recomputed by add() and mul(). Intermediate results have their leading bit at bit 30, the
+		// 7 bits below the last bit of the result are kept, and all further bits are merged into bit 0
+		constexpr std::uint32_t gemm_lane_lsb_shift = 30 - float_parts::num_fraction_bits;
+
+		// Returns whether a biased exponent is that of a zero, subnormal, infinity, or NaN
+		[[nodiscard]] constexpr std::uint32_t gemm_lane_special(std::uint32_t exponent) {
+			return exponent - 1u >= (1u << float_parts::num_exponent_bits) - 2 ? 1u : 0u;
+		}
+
+		// Rounds an intermediate result. Flags the lane if the result is not normal
+		template <rounding_mode Rounding> [[nodiscard]] constexpr std::uint32_t gemm_lane_round(
+			std::uint32_t negative, std::uint32_t exponent, std::uint32_t r, std::uint32_t &slow
+		) {
+			const std::uint32_t rf = r >> gemm_lane_lsb_shift;
+			const std::uint32_t truncated_bits = r << (32 - gemm_lane_lsb_shift);
+			const std::uint32_t inc = rounding_increment(Rounding, negative != 0, (rf & 1u) != 0, truncated_bits);
+			slow = gemm_lane_special(exponent);
+			// Adding the fraction with its implicit bit increments the exponent, and rounding may carry into it
+			return (negative << 31) + ((exponent - 1u) << float_parts::num_fraction_bits) + rf + inc;
+		}
+
+		template <rounding_mode Rounding> [[nodiscard]] constexpr std::uint32_t gemm_lane_mul(
+			std::uint32_t x, std::uint32_t y, std::uint32_t &slow
+		) {
+			const std::uint32_t xe = (x & float_parts::exponent_mask) >> float_parts::num_fraction_bits;
+			const std::uint32_t ye = (y & float_parts::exponent_mask) >> float_parts::num_fraction_bits;
+			const std::uint32_t x_zero = (x & ~float_parts::sign_mask) == 0 ? 1u : 0u;
+			const std::uint32_t y_zero = (y & ~float_parts::sign_mask) == 0 ? 1u : 0u;
+			const std::uint32_t zero = x_zero | y_zero;
+			const std::uint32_t negative = (x ^ y) >> 31;
+
+			const std::uint64_t xf = (x & float_parts::fraction_mask) | (1u << float_parts::num_fraction_bits);
+			const std::uint64_t yf = (y & float_parts::fraction_mask) | (1u << float_parts::num_fraction_bits);
+			const std::uint64_t product = xf * yf;
+			// The product has its leading bit at bit 46, or at bit 47 if it carries. Both shifts are computed, since
+			// variable shifts of 64-bit lanes do not vectorize everywhere
+			const auto carry = static_cast<std::uint32_t>(product >> (2 * float_parts::num_fraction_bits + 1));
+			constexpr std::uint32_t shift = 2 * float_parts::num_fraction_bits - 30;
+			const auto low = static_cast<std::uint32_t>(product);
+			const std::uint32_t r_no_carry =
+				static_cast<std::uint32_t>(product >> shift) | ((low & ((1u << shift) - 1)) != 0 ? 1u : 0u);
+			const std::uint32_t r_carry =
+				static_cast<std::uint32_t>(product >> (shift + 1)) | ((low & ((1u << (shift + 1)) - 1)) != 0 ? 1u : 0u);
+			const std::uint32_t r = carry != 0 ? r_carry : r_no_carry;
+
+			std::uint32_t round_slow = 0;
+			const std::uint32_t result = gemm_lane_round<Rounding>(
+				negative, xe + ye + carry - float_parts::exponent_offset, r, round_slow
+			);
+			// Zeros times normal numbers and zeros are exact
+			slow =
+				(gemm_lane_special(xe) & (1u - x_zero)) | (gemm_lane_special(ye) & (1u - y_zero)) |
+				(round_slow & (1u - zero));
+			return zero != 0 ? negative << 31 : result;
+		}
+
+		template <rounding_mode Rounding> [[nodiscard]] constexpr std::uint32_t gemm_lane_add(
+			std::uint32_t x, std::uint32_t y, std::uint32_t &slow
+		) {
+			// Order the operands so that big has the larger magnitude
+			const bool swap = (y & ~float_parts::sign_mask) > (x & ~float_parts::sign_mask);
+			const std::uint32_t big = swap ? y : x;
+			const std::uint32_t small = swap ? x : y;
+			const std::uint32_t be = (big & float_parts::exponent_mask) >> float_parts::num_fraction_bits;
+			const std::uint32_t se = (small & float_parts::exponent_mask) >> float_parts::num_fraction_bits;
+			const std::uint32_t big_zero = (big & ~float_parts::sign_mask) == 0 ? 1u : 0u;
+			const std::uint32_t small_zero = (small & ~float_parts::sign_mask) == 0 ? 1u : 0u;
+			const std::uint32_t subtract = (x ^ y) >> 31;
+
+			// The larger fraction has its leading bit at bit 29, leaving room for the carry
+			constexpr std::uint32_t guard_bits = 29 - float_parts::num_fraction_bits;
+			constexpr std::uint32_t implicit_bit = 1u << float_parts::num_fraction_bits;
+			const std::uint32_t bf = ((big & float_parts::fraction_mask) | implicit_bit) << guard_bits;
+			const std::uint32_t sf =
+				small_zero != 0 ? 0u : ((small & float_parts::fraction_mask) | implicit_bit) << guard_bits;
+			const std::uint32_t sf_shift = std::min(be - se, 31u);
+			const std::uint32_t sf_sticky = (sf & ((1u << sf_shift) - 1)) != 0 ? 1u : 0u;
+			const std::uint32_t sf_aligned = (sf >> sf_shift) | sf_sticky;
+			std::uint32_t r = subtract != 0 ? bf - sf_aligned : bf + sf_aligned;
+
+			// Shift the leading bit to bit 30 by binary search, since vector instructions for counting leading zeros
+			// are not available at all levels
+			std::uint32_t shift = 0;
+			for (const std::uint32_t step : { 16u, 8u, 4u, 2u, 1u }) {
+				const std::uint32_t step_shift = (r >> (31 - step)) == 0 ? step : 0u;
+				r <<= step_shift;
+				shift += step_shift;
+			}
+
+			std::uint32_t round_slow = 0;
+			const std::uint32_t result = gemm_lane_round<Rounding>(big >> 31, be + 1 - shift, r, round_slow);
+			// Exact cancellation produces -0 only when rounding downward
+			const std::uint32_t cancelled = Rounding == rounding_mode::downward ? float_parts::sign_mask : 0u;
+			slow =
+				(gemm_lane_special(be) & (1u - big_zero)) | (gemm_lane_special(se) & (1u - small_zero)) |
+				(round_slow & (1u - big_zero) & (r != 0 ? 1u : 0u));
+			const std::uint32_t zero_result = big_zero != 0 && subtract == 0 ? x : cancelled;
+			return big_zero != 0 || r == 0 ? zero_result : result;
+		}
+
+		// Adds the product of a packed slice of a and a packed slice of b to a full tile of c. For every k, the packed
+		// a holds gemm_tile_rows values and the packed b holds gemm_tile_cols values. Tiles at the edges of c are
+		// copied to a padded tile by the caller, since loops with a variable trip count here prevent vectorization.
+		// Without Lanes, each step calls add() and mul() instead of the branch-free functions
+		template <rounding_mode Rounding, bool Lanes> struct gemm_micro_kernel {
+			void operator()(std::size_t depth, const float *a, const float *b, float *c, std::size_t c_stride) const {
+				std::array<std::uint32_t, gemm_tile_rows * gemm_tile_cols> acc;
+				for (std::size_t r = 0; r < gemm_tile_rows; ++r) {
+					for (std::size_t col = 0; col < gemm_tile_cols; ++col) {
+						acc[r * gemm_tile_cols + col] = std::bit_cast<std::uint32_t>(c[r * c_stride + col]);
+					}
+				}
+				// Each accumulator is updated once per k in order, and the columns of a tile row are computed together
+				for (std::size_t p = 0; p < depth; ++p) {
+					const float *bp = b + p * gemm_tile_cols;
+					for (std::size_t r = 0; r < gemm_tile_rows; ++r) {
+						const float av = a[p * gemm_tile_rows + r];
+						const auto ab = std::bit_cast<std::uint32_t>(av);
+						std::uint32_t *acc_row = acc.data() + r * gemm_tile_cols;
+						if constexpr (!Lanes) {
+							for (std::size_t col = 0; col < gemm_tile_cols; ++col) {
+								acc_row[col] = std::bit_cast<std::uint32_t>(add<Rounding>(
+									std::bit_cast<float>(acc_row[col]), mul<Rounding>(av, bp[col])
+								));
+							}
+							continue;
+						}
+						std::array<std::uint32_t, gemm_tile_cols> previous;
+						std::array<std::uint32_t, gemm_tile_cols> slow;
+						std::uint32_t any_slow = 0;
+						for (std::size_t col = 0; col < gemm_tile_cols; ++col) {
+							std::uint32_t mul_slow = 0;
+							std::uint32_t add_slow = 0;
+							previous[col] = acc_row[col];
+							const std::uint32_t product = gemm_lane_mul<Rounding>(
+								ab, std::bit_cast<std::uint32_t>(bp[col]), mul_slow
+							);
+							acc_row[col] = gemm_lane_add<Rounding>(acc_row[col], product, add_slow);
+							slow[col] = mul_slow | add_slow;
+							any_slow |= slow[col];
+						}
+						if (any_slow != 0) [[unlikely]] {
+							for (std::size_t col = 0; col < gemm_tile_cols; ++col) {
+								if (slow[col] != 0) {
+									acc_row[col] = std::bit_cast<std::uint32_t>(add<Rounding>(
+										std::bit_cast<float>(previous[col]), mul<Rounding>(av, bp[col])
+									));
+								}
+							}
+						}
+					}
+				}
+				for (std::size_t r = 0; r < gemm_tile_rows; ++r) {
+					for (std::size_t col = 0; col < gemm_tile_cols; ++col) {
+						c[r * c_stride + col] = std::bit_cast<float>(acc[r * gemm_tile_cols + col]);
+					}
+				}
+			}
+		};
+
+		// Computes one block of c, given its first row and column
+		template <rounding_mode Rounding> void gemm_block(
+			std::size_t m, std::size_t n, std::size_t k,
+			std::span<const float> a, std::span<const float> b, std::span<float> c,
+			std::size_t row0, std::size_t col0, std::vector<float> &packed_a, std::vector<float> &packed_b
+		) {
+			const std::size_t rows = std::min(gemm_block_rows, m - row0);
+			const std::size_t cols = std::min(gemm_block_cols, n - col0);
+			const std::size_t row_tiles = (rows + gemm_tile_rows - 1) / gemm_tile_rows;
+			const std::size_t col_tiles = (cols + gemm_tile_cols - 1) / gemm_tile_cols;
+			packed_a.resize(row_tiles * gemm_tile_rows * gemm_block_depth);
+			packed_b.resize(col_tiles * gemm_tile_cols * gemm_block_depth);
+
+			// Slices of k are processed in increasing order, so each element of c is still accumulated in order
+			for (std::size_t p0 = 0; p0 < k; p0 += gemm_block_depth) {
+				const std::size_t depth = std::min(gemm_block_depth, k - p0);
+				for (std::size_t tile = 0; tile < row_tiles; ++tile) {
+					float *dst = packed_a.data() + tile * gemm_tile_rows * depth;
+					for (std::size_t p = 0; p < depth; ++p) {
+						for (std::size_t r = 0; r < gemm_tile_rows; ++r) {
+							const std::size_t row = tile * gemm_tile_rows + r;
+							dst[p * gemm_tile_rows + r] = row < rows ? a[(row0 + row) * k + p0 + p] : 0.0f;
+						}
+					}
+				}
+				for (std::size_t tile = 0; tile < col_tiles; ++tile) {
+					float *dst = packed_b.data() + tile * gemm_tile_cols * depth;
+					for (std::size_t p = 0; p < depth; ++p) {
+						for (std::size_t col = 0; col < gemm_tile_cols; ++col) {
+							const std::size_t column = tile * gemm_tile_cols + col;
+							dst[p * gemm_tile_cols + col] = column < cols ? b[(p0 + p) * n + col0 + column] : 0.0f;
+						}
+					}
+				}
+
+				for (std::size_t row_tile = 0; row_tile < row_tiles; ++row_tile) {
+					for (std::size_t col_tile = 0; col_tile < col_tiles; ++col_tile) {
+						const std::size_t row = row_tile * gemm_tile_rows;
+						const std::size_t col = col_tile * gemm_tile_cols;
+						const std::size_t tile_rows = std::min(gemm_tile_rows, rows - row);
+						const std::size_t tile_cols = std::min(gemm_tile_cols, cols - col);
+						float *tile = c.data() + (row0 + row) * n + col0 + col;
+						auto run = [&](float *dst, std::size_t stride) {
+							const float *tile_a = packed_a.data() + row_tile * gemm_tile_rows * depth;
+							const float *tile_b = packed_b.data() + col_tile * gemm_tile_cols * depth;
+#ifdef FLOAT_UTILS_SIMD_DISPATCH
+							// Baseline x86-64 cannot shift vector lanes by different amounts, so the branch-free
+							// functions do not vectorize there and are slower than add() and mul()
+							if (get_simd_level() == simd_level::scalar) {
+								using kernel = gemm_micro_kernel<Rounding, false>;
+								run_kernel_scalar<kernel>(depth, tile_a, tile_b, dst, stride);
+								return;
+							}
+#endif
+							dispatch_kernel<gemm_micro_kernel<Rounding, true>>(depth, tile_a, tile_b, dst, stride);
+						};
+						if (tile_rows == gemm_tile_rows && tile_cols == gemm_tile_cols) {
+							run(tile, n);
+						} else {
+							// The padding of the tile only accumulates products of the zero padding of the slices
+							std::array<float, gemm_tile_rows * gemm_tile_cols> padded{};
+							for (std::size_t r = 0; r < tile_rows; ++r) {
+								std::copy_n(tile + r * n, tile_cols, padded.begin() + r * gemm_tile_cols);
+							}
+							run(padded.data(), gemm_tile_cols);
+							for (std::size_t r = 0; r < tile_rows; ++r) {
+								std::copy_n(padded.begin() + r * gemm_tile_cols, tile_cols, tile + r * n);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Multiplies the m x k matrix a by the k x n matrix b and adds the product to the m x n matrix c. All matrices are
+	// stored in row-major order. Each element of c is accumulated in order of increasing k, as
+	// (((c + a[i][0] * b[0][j]) + a[i][1] * b[1][j]) + ...), with every product and sum rounded using the rounding
+	// mode. The results are therefore the same as those of the naive loop, independent of the instruction set and the
+	// number of threads. Blocks of c are distributed between num_threads threads, or one thread per core if it is 0
+	template <rounding_mode Rounding = rounding_mode::nearest_tie_to_even> void gemm(
+		std::size_t m, std::size_t n, std::size_t k,
+		std::span<const float> a, std::span<const float> b, std::span<float> c, std::size_t num_threads = 0
+	) {
+		static_assert(
+			Rounding != rounding_mode::stochastic,
+			"Stochastic rounding depends on the random stream of each thread and is not reproducible"
+		);
+		if constexpr (Rounding == rounding_mode::system) {
+			// Worker threads do not share the floating point environment of this thread
+			switch (get_system_rounding_mode()) {
+			case rounding_mode::downward:
+				return gemm<rounding_mode::downward>(m, n, k, a, b, c, num_threads);
+			case rounding_mode::upward:
+				return gemm<rounding_mode::upward>(m, n, k, a, b, c, num_threads);
+			case rounding_mode::toward_zero:
+				return gemm<rounding_mode::toward_zero>(m, n, k, a, b, c, num_threads);
+			default:
+				return gemm<rounding_mode::nearest_tie_to_even>(m, n, k, a, b, c, num_threads);
+			}
+		} else {
+			const std::size_t block_rows = (m + _details::gemm_block_rows - 1) / _details::gemm_block_rows;
+			const std::size_t block_cols = (n + _details::gemm_block_cols - 1) / _details::gemm_block_cols;
+			const std::size_t num_blocks = block_rows * block_cols;
+			if (num_threads == 0) {
+				num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+			num_threads = std::min(num_threads, num_blocks);
+
+			// Blocks are claimed dynamically. Which thread computes a block does not affect its result
+			std::atomic<std::size_t> next_block = 0;
+			auto worker = [&]() {
+				std::vector<float> packed_a;
+				std::vector<float> packed_b;
+				for (
+					std::size_t block = next_block.fetch_add(1, std::memory_order_relaxed);
+					block < num_blocks;
+					block = next_block.fetch_add(1, std::memory_order_relaxed)
+				) {
+					_details::gemm_block<Rounding>(
+						m, n, k, a, b, c,
+						block / block_cols * _details::gemm_block_rows, block % block_cols * _details::gemm_block_cols,
+						packed_a, packed_b
+					);
+				}
+			};
+			std::vector<std::thread> threads;
+			for (std::size_t i = 1; i < num_threads; ++i) {
+				threads.emplace_back(worker);
+			}
+			worker();
+			for (std::thread &thread : threads) {
+				thread.join();
+			}
+		}
+	}
+}
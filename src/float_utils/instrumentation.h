@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+
+namespace float_utils {
+	// Internal paths of the arithmetic operators that can be counted by instrumentation policies
+	enum class operator_path : std::uint32_t {
+		add_swap, // The operands are swapped so that x has the larger magnitude
+		add_subnormal_operand, // y is zero or subnormal
+		add_cancellation, // The operands cancel exactly
+		add_extra_bit, // The sum produces an extra bit above the implicit bit
+		add_subnormal_result, // The result is subnormal
+
+		mul_special_operand, // At least one operand is zero or subnormal
+		mul_extra_bit, // The product produces an extra bit above the implicit bit
+		mul_subnormal_result, // The result is subnormal
+
+		div_special_operand, // At least one operand is zero or subnormal
+		div_remainder, // The division produces a non-zero remainder
+		div_subnormal_result, // The result is subnormal
+
+		round_overflow, // The result is too large to be represented
+		round_overflow_to_max, // The result is too large, and is rounded to the largest finite value
+		round_tie, // The truncated bits are exactly half of the last fraction bit
+		round_increment, // The magnitude of the result is incremented by rounding
+
+		count
+	};
+	constexpr std::size_t num_operator_paths = static_cast<std::size_t>(operator_path::count);
+
+	[[nodiscard]] constexpr std::string_view get_operator_path_name(operator_path path) {
+		constexpr std::array<std::string_view, num_operator_paths> names{
+			"add_swap", "add_subnormal_operand", "add_cancellation", "add_extra_bit", "add_subnormal_result",
+			"mul_special_operand", "mul_extra_bit", "mul_subnormal_result",
+			"div_special_operand", "div_remainder", "div_subnormal_result",
+			"round_overflow", "round_overflow_to_max", "round_tie", "round_increment"
+		};
+		return names[static_cast<std::size_t>(path)];
+	}
+
+	// Instrumentation policy that records nothing. Calls to hit() compile away completely
+	struct no_instrumentation {
+		constexpr static void hit(operator_path) {
+		}
+	};
+
+	// Instrumentation policy that counts how many times each path has been taken. Each thread has its own counters, so
+	// counting needs no synchronization; results from multiple threads can be combined using snapshot(). Nothing is
+	// recorded during constant evaluation
+	struct path_counters {
+		using counters = std::array<std::uint64_t, num_operator_paths>;
+
+		constexpr static void hit(operator_path path) {
+			if (!std::is_constant_evaluated()) {
+				++_get_counters()[static_cast<std::size_t>(path)];
+			}
+		}
+
+		// Returns the counters of the current thread
+		[[nodiscard]] static counters snapshot() {
+			return _get_counters();
+		}
+		// Resets the counters of the current thread
+		static void reset() {
+			_get_counters().fill(0);
+		}
+		// Writes the counters of a thread, with paths that have never been taken marked explicitly. If an operator name
+		// such as "add" is given, only the paths of that operator and the rounding paths it shares with all other
+		// operators are written
+		static void write_report(std::ostream &out, const counters &values, std::string_view operator_name = {}) {
+			for (std::size_t i = 0; i < num_operator_paths; ++i) {
+				const std::string_view name = get_operator_path_name(static_cast<operator_path>(i));
+				const bool selected =
+					operator_name.empty() || name.starts_with("round_") ||
+					(name.starts_with(operator_name) && name.substr(operator_name.size()).starts_with('_'));
+				if (!selected) {
+					continue;
+				}
+				out << "  " << name << ": " << values[i];
+				if (values[i] == 0) {
+					out << " (never taken)";
+				}
+				out << "\n";
+			}
+		}
+		static void write_report(std::ostream &out, std::string_view operator_name = {}) {
+			write_report(out, _get_counters(), operator_name);
+		}
+	private:
+		[[nodiscard]] static counters &_get_counters() {
+			thread_local counters values{};
+			return values;
+		}
+	};
+}
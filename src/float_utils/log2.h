@@ -1,6 +1,9 @@
 #pragma once
 
+#include <array>
+#include <bit>
 #include <cmath>
+#include <cstdint>
 #include <limits>
 
 #include "float_parts.h"
@@ -44,4 +47,94 @@ namespace float_utils {
 
 		return result;
 	}
+
+	namespace _details {
+		// Coefficients of a polynomial approximation of log2(1 + z) / z on [sqrt(2) / 2 - 1, sqrt(2) - 1], from the
+		// constant term upwards, as Q1.30 numbers. Interpolated at Chebyshev nodes, with a relative error below 2^-29
+		constexpr std::array<std::int32_t, 11> log2_fixed_coefficients{
+			1549082006, -774540993, 516360193, -387271467, 309855680, -258178613,
+			220160046, -192408707, 185051450, -180013374, 101810738
+		};
+
+		// Converts a non-zero signed fixed-point number with the given number of fraction bits to a float, rounding to
+		// nearest. The result must be in the normal range
+		[[nodiscard]] constexpr float fixed_to_float(std::int64_t value, std::uint32_t fraction_bits) {
+			const bool sign = value < 0;
+			std::uint64_t magnitude = sign ? 0ull - static_cast<std::uint64_t>(value) : static_cast<std::uint64_t>(value);
+			const auto zeros = static_cast<std::uint32_t>(std::countl_zero(magnitude));
+			magnitude <<= zeros;
+			const auto rf = static_cast<std::uint32_t>(magnitude >> (63 - float_parts::num_fraction_bits));
+			const std::uint64_t truncated_bits_full = magnitude << (float_parts::num_fraction_bits + 1);
+			const std::uint32_t truncated_bits =
+				static_cast<std::uint32_t>(truncated_bits_full >> 32) |
+				(static_cast<std::uint32_t>(truncated_bits_full) != 0 ? 1u : 0u);
+			const auto re = static_cast<std::uint32_t>(
+				static_cast<std::int32_t>(float_parts::exponent_offset + 63 - zeros - fraction_bits)
+			);
+			return round_result(rounding_mode::nearest_tie_to_even, sign, re, rf, truncated_bits, false);
+		}
+	}
+
+	// Integer-only version of log2() for targets without an FPU, using a fixed-point polynomial. The results are the
+	// same on all platforms, and are within one ulp of the exact result
+	[[nodiscard]] constexpr float log2_fixed(float x) {
+		const std::uint32_t bits = std::bit_cast<std::uint32_t>(x);
+		const std::uint32_t biased_exponent = float_parts::get_exponent(x);
+		std::uint32_t xf = float_parts::get_fraction(x);
+		if ((bits & ~float_parts::sign_mask) == 0) {
+			return -std::numeric_limits<float>::infinity();
+		}
+		if (biased_exponent == (1u << float_parts::num_exponent_bits) - 1 && xf != 0) {
+			// NaNs are made quiet
+			return std::bit_cast<float>(bits | (1u << (float_parts::num_fraction_bits - 1)));
+		}
+		if (float_parts::get_sign(x)) {
+			return std::numeric_limits<float>::quiet_NaN();
+		}
+		if (biased_exponent == (1u << float_parts::num_exponent_bits) - 1) {
+			return x;
+		}
+
+		std::int32_t exponent = float_parts::get_offset_exponent(x);
+		if (biased_exponent == 0) {
+			exponent = _details::normalize_subnormal(xf);
+		} else {
+			xf |= 1u << float_parts::num_fraction_bits;
+		}
+
+		// x = 2^exponent * (1 + z), where z is a Q0.31 number in [sqrt(2) / 2 - 1, sqrt(2) - 1), so that the result
+		// is close to zero only when the exponent is zero
+		constexpr std::uint32_t one = 1u << float_parts::num_fraction_bits;
+		constexpr std::uint32_t sqrt2 = 0xB504F3u;
+		// Written without branches, since the comparison is unpredictable
+		const std::uint32_t halve = xf > sqrt2 ? 1u : 0u;
+		exponent += static_cast<std::int32_t>(halve);
+		const std::int32_t z =
+			static_cast<std::int32_t>(xf - (one << halve)) << (31 - float_parts::num_fraction_bits - halve);
+		if (z == 0) {
+			// Powers of two produce exact integers
+			return exponent == 0 ? 0.0f : _details::fixed_to_float(exponent, 0);
+		}
+
+		// log2(1 + z) = z * q(z), where q(z) is evaluated as a Q1.30 number using Estrin's scheme, which has a much
+		// shorter dependency chain than Horner's method
+		constexpr const auto &c = _details::log2_fixed_coefficients;
+		auto mul = [](std::int64_t a, std::int64_t b) {
+			return (a * b) >> 31;
+		};
+		const std::int64_t z2 = mul(z, z);
+		const std::int64_t z4 = mul(z2, z2);
+		const std::int64_t z8 = mul(z4, z4);
+		const std::int64_t q =
+			(c[0] + mul(c[1], z)) + mul(c[2] + mul(c[3], z), z2) +
+			mul((c[4] + mul(c[5], z)) + mul(c[6] + mul(c[7], z), z2), z4) +
+			mul((c[8] + mul(c[9], z)) + mul(c[10], z2), z8);
+		// log2(1 + z) as a Q2.61 number
+		const std::int64_t fraction_log = static_cast<std::int64_t>(z) * q;
+		if (exponent == 0) {
+			return _details::fixed_to_float(fraction_log, 61);
+		}
+		// The magnitude of the result is at least 1/2, so 32 fraction bits are enough
+		return _details::fixed_to_float((static_cast<std::int64_t>(exponent) << 32) + (fraction_log >> 29), 32);
+	}
 }
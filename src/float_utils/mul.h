@@ -1,10 +1,83 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <span>
+
+#include "category.h"
+#include "dispatch.h"
 #include "float_parts.h"
 #include "utils.h"
 
 namespace float_utils {
-	template <rounding_mode Rounding = rounding_mode::system> float mul(float x, float y) {
+	namespace _details {
+		// Multiplies two numbers given their offset exponents and normalized fractions with the implicit bit set
+		template <rounding_mode Rounding, typename Instrumentation> constexpr float mul_normalized(
+			bool rp, std::int32_t xe, std::uint32_t xf, std::int32_t ye, std::uint32_t yf
+		) {
+			const std::uint64_t rf_raw = static_cast<std::uint64_t>(xf) * static_cast<std::uint64_t>(yf);
+			const bool rf_extra_bit = rf_raw & (1ULL << (2 * float_parts::num_fraction_bits + 1));
+			if (rf_extra_bit) {
+				Instrumentation::hit(operator_path::mul_extra_bit);
+			}
+
+			const std::uint32_t rf_shiftr = float_parts::num_fraction_bits + (rf_extra_bit ? 1 : 0);
+			auto rf = static_cast<std::uint32_t>(rf_raw >> rf_shiftr);
+			auto truncated_bits = static_cast<std::uint32_t>(rf_raw << (32 - rf_shiftr));
+
+			const std::int32_t re_raw =
+				xe + ye + (rf_extra_bit ? 1 : 0) + static_cast<std::int32_t>(float_parts::exponent_offset);
+			std::uint32_t re = std::min(
+				static_cast<std::uint32_t>(re_raw),
+				(1u << float_parts::num_exponent_bits) - 1
+			);
+			if (re_raw <= 0) [[unlikely]] {
+				// The result is subnormal
+				Instrumentation::hit(operator_path::mul_subnormal_result);
+				denormalize(rf, truncated_bits, static_cast<std::uint32_t>(1 - re_raw));
+				re = 0;
+			}
+			const bool is_inf = re >= (1u << float_parts::num_exponent_bits) - 1;
+
+			// Round and return
+			const rounding_mode rounding = Rounding == rounding_mode::system ? get_system_rounding_mode() : Rounding;
+			return round_result<Instrumentation>(rounding, rp, re, rf, truncated_bits, is_inf);
+		}
+
+		// Handles the case where at least one of x and y is zero or subnormal
+		template <rounding_mode Rounding, typename Instrumentation> constexpr float mul_subnormal(float x, float y) {
+			const bool rp = float_parts::get_sign(x) != float_parts::get_sign(y);
+
+			if (is_zero(x) || is_zero(y)) {
+				return rp ? -0.0f : 0.0f;
+			}
+
+			std::int32_t xe = float_parts::get_offset_exponent(x);
+			std::int32_t ye = float_parts::get_offset_exponent(y);
+			std::uint32_t xf = float_parts::get_fraction(x);
+			std::uint32_t yf = float_parts::get_fraction(y);
+			if (float_parts::get_exponent(x) == 0) {
+				xe = normalize_subnormal(xf);
+			} else {
+				xf |= 1u << float_parts::num_fraction_bits;
+			}
+			if (float_parts::get_exponent(y) == 0) {
+				ye = normalize_subnormal(yf);
+			} else {
+				yf |= 1u << float_parts::num_fraction_bits;
+			}
+			return mul_normalized<Rounding, Instrumentation>(rp, xe, xf, ye, yf);
+		}
+	}
+
+	template <
+		rounding_mode Rounding = rounding_mode::system, typename Instrumentation = no_instrumentation
+	> constexpr float mul(float x, float y) {
+		if (float_parts::get_exponent(x) == 0 || float_parts::get_exponent(y) == 0) [[unlikely]] {
+			Instrumentation::hit(operator_path::mul_special_operand);
+			return _details::mul_subnormal<Rounding, Instrumentation>(x, y);
+		}
+
 		const bool xp = float_parts::get_sign(x);
 		const bool yp = float_parts::get_sign(y);
 
@@ -14,27 +87,28 @@ namespace float_utils {
 		const std::uint32_t xf = float_parts::get_fraction(x) | (1u << float_parts::num_fraction_bits);
 		const std::uint32_t yf = float_parts::get_fraction(y) | (1u << float_parts::num_fraction_bits);
 
-		const std::uint64_t rf_raw = static_cast<std::uint64_t>(xf) * static_cast<std::uint64_t>(yf);
-		const bool rf_extra_bit = rf_raw & (1ULL << (2 * float_parts::num_fraction_bits + 1));
+		return _details::mul_normalized<Rounding, Instrumentation>(xp != yp, xe, xf, ye, yf);
+	}
 
-		const std::uint32_t rf_shiftr = float_parts::num_fraction_bits + (rf_extra_bit ? 1 : 0);
-		const auto rf = static_cast<std::uint32_t>(rf_raw >> rf_shiftr);
-		const auto truncated_bits = static_cast<std::uint32_t>(rf_raw << (32 - rf_shiftr));
+	namespace _details {
+		template <rounding_mode Rounding> struct mul_batch_kernel {
+			constexpr void operator()(std::span<const float> x, std::span<const float> y, std::span<float> out) const {
+				for (std::size_t i = 0; i < x.size(); ++i) {
+					out[i] = mul<Rounding>(x[i], y[i]);
+				}
+			}
+		};
+	}
 
-		const bool rp = xp != yp;
-		const std::int32_t re_raw =
-			xe + ye + (rf_extra_bit ? 1 : 0) + static_cast<std::int32_t>(float_parts::exponent_offset);
-		if (re_raw <= 0) {
-			return 0.0f;
+	// Computes mul(x[i], y[i]) for all elements, in the same way as add_batch()
+	template <rounding_mode Rounding = rounding_mode::system> constexpr void mul_batch(
+		std::span<const float> x, std::span<const float> y, std::span<float> out
+	) {
+		using kernel = _details::mul_batch_kernel<Rounding>;
+		if (std::is_constant_evaluated()) {
+			kernel{}(x, y, out);
+		} else {
+			_details::dispatch_kernel<kernel>(x, y, out);
 		}
-		const bool is_inf = re_raw >= (1u << float_parts::num_exponent_bits) - 1;
-		const std::uint32_t re = std::min(
-			static_cast<std::uint32_t>(re_raw),
-			(1u << float_parts::num_exponent_bits) - 1
-		);
-
-		// Round and return
-		const rounding_mode rounding = Rounding == rounding_mode::system ? get_system_rounding_mode() : Rounding;
-		return round_result(rounding, rp, re, rf, truncated_bits, is_inf);
 	}
 }
@@ -1,17 +1,23 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
 #include "float_parts.h"
+#include "utils.h"
 
 namespace float_utils {
-	template <std::uint32_t NewtonIterations = 1> float rcp(float x) {
+	namespace _details {
 		// Constant used for linear approximation of 1/xf, best when using different number of Newton iterations
-		constexpr std::uint32_t magic_0 = 0x7FFF81u;
-		constexpr std::uint32_t magic_1 = 0x7FF4B0u;
-		constexpr std::uint32_t magic_2 = 0x7CBC40u;
-		constexpr std::uint32_t magic =
-			NewtonIterations == 0 ? magic_0 :
-			NewtonIterations == 1 ? magic_1 :
-			magic_2;
+		template <std::uint32_t NewtonIterations> constexpr std::uint32_t rcp_magic =
+			NewtonIterations == 0 ? 0x7FFF81u :
+			NewtonIterations == 1 ? 0x7FF4B0u :
+			0x7CBC40u;
+	}
+
+	template <std::uint32_t NewtonIterations = 1> float rcp(float x) {
+		constexpr std::uint32_t magic = _details::rcp_magic<NewtonIterations>;
 
 #if 0
 		// Verbose version
@@ -33,4 +39,53 @@ namespace float_utils {
 
 		return result;
 	}
+
+	// Integer-only version of rcp() for targets without an FPU. The Newton iterations are computed in fixed point, so
+	// the results are the same on all platforms. Unlike rcp(), zeros, infinities, NaNs and subnormal inputs and results
+	// are handled in the same way as 1.0f / x
+	template <std::uint32_t NewtonIterations = 3> constexpr float rcp_fixed(float x) {
+		const std::uint32_t bits = std::bit_cast<std::uint32_t>(x);
+		const bool xp = float_parts::get_sign(x);
+		const std::uint32_t biased_exponent = float_parts::get_exponent(x);
+		std::uint32_t xf = float_parts::get_fraction(x);
+		if (biased_exponent == (1u << float_parts::num_exponent_bits) - 1) {
+			// Infinities produce zeros, and NaNs are made quiet
+			const std::uint32_t quiet_bit = 1u << (float_parts::num_fraction_bits - 1);
+			return std::bit_cast<float>(xf == 0 ? bits & float_parts::sign_mask : bits | quiet_bit);
+		}
+		if (biased_exponent == 0 && xf == 0) {
+			return std::bit_cast<float>((bits & float_parts::sign_mask) | float_parts::exponent_mask);
+		}
+		std::int32_t xe = float_parts::get_offset_exponent(x);
+		if (biased_exponent == 0) {
+			xe = _details::normalize_subnormal(xf);
+			xf &= float_parts::fraction_mask;
+		}
+
+		// The fraction m in [1, 2) as a Q1.31 number, and the linear approximation of 1/m from rcp() as a Q2.30
+		// number
+		const std::uint32_t m = (xf | (1u << float_parts::num_fraction_bits)) << (31 - float_parts::num_fraction_bits);
+		std::uint32_t y = ((1u << float_parts::num_fraction_bits) + _details::rcp_magic<NewtonIterations> - xf) <<
+			(30 - (float_parts::num_fraction_bits + 1));
+		for (std::uint32_t i = 0; i < NewtonIterations; ++i) {
+			// y = y * (2 - m * y), where m * y and 2 - m * y are Q1.31 numbers
+			const std::uint64_t my = (static_cast<std::uint64_t>(m) * y) >> 30;
+			y = static_cast<std::uint32_t>((static_cast<std::uint64_t>(y) * ((2ull << 31) - my)) >> 31);
+		}
+
+		// Normalize y so that its highest bit becomes the implicit bit, and round the result to nearest
+		const auto top_bit = static_cast<std::uint32_t>(31 - std::countl_zero(y));
+		const std::uint32_t shift = top_bit - float_parts::num_fraction_bits;
+		std::uint32_t rf = y >> shift;
+		std::uint32_t truncated_bits = shift == 0 ? 0u : y << (32 - shift);
+		const std::int32_t re_raw =
+			static_cast<std::int32_t>(float_parts::exponent_offset) - xe + static_cast<std::int32_t>(top_bit) - 30;
+		std::uint32_t re = std::min(static_cast<std::uint32_t>(re_raw), (1u << float_parts::num_exponent_bits) - 1);
+		if (re_raw <= 0) {
+			_details::denormalize(rf, truncated_bits, static_cast<std::uint32_t>(1 - re_raw));
+			re = 0;
+		}
+		const bool is_inf = re >= (1u << float_parts::num_exponent_bits) - 1;
+		return round_result(rounding_mode::nearest_tie_to_even, xp, re, rf, truncated_bits, is_inf);
+	}
 }
@@ -1,11 +1,15 @@
 #pragma once
 
-#include <optional>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <span>
 
+#include "dispatch.h"
 #include "float_parts.h"
 
 namespace float_utils {
-	float trunc(float x) {
+	constexpr float trunc(float x) {
 		const std::int32_t xe = float_parts::get_offset_exponent(x);
 		if (xe >= static_cast<std::int32_t>(float_parts::num_fraction_bits)) {
 			return x;
@@ -18,7 +22,7 @@ namespace float_utils {
 		return std::bit_cast<float>(std::bit_cast<std::uint32_t>(x) & ~((1u << num_trunc_bits) - 1));
 	}
 
-	float round(float x) {
+	constexpr float round(float x) {
 		const std::int32_t xe = float_parts::get_offset_exponent(x);
 		if (xe >= static_cast<std::int32_t>(float_parts::num_fraction_bits)) {
 			return x;
@@ -40,7 +44,7 @@ namespace float_utils {
 		return std::bit_cast<float>(result_bits);
 	}
 
-	float floor(float x) {
+	constexpr float floor(float x) {
 		const std::int32_t xe = float_parts::get_offset_exponent(x);
 		if (xe >= static_cast<std::int32_t>(float_parts::num_fraction_bits)) {
 			return x;
@@ -65,7 +69,79 @@ namespace float_utils {
 		return std::bit_cast<float>(result_bits);
 	}
 
-	float ceil(float x) {
+	constexpr float ceil(float x) {
 		return -floor(-x);
 	}
+
+	namespace _details {
+		// Branchless versions of the functions above operating on bit patterns, used for vectorized batch processing.
+		// Each computes a mask of the fraction bits below the decimal point, which is then cleared
+
+		// Returns the fraction bits of a value with the given offset exponent that are below the decimal point, or all
+		// bits except for the sign bit if the absolute value is less than 1
+		[[nodiscard]] constexpr std::uint32_t fractional_mask(std::int32_t exponent) {
+			const auto shift = static_cast<std::uint32_t>(std::clamp<std::int32_t>(exponent, 0, 31));
+			return exponent < 0 ? ~float_parts::sign_mask : float_parts::fraction_mask >> shift;
+		}
+
+		[[nodiscard]] constexpr std::uint32_t trunc_bits(std::uint32_t bits) {
+			const std::int32_t exponent = float_parts::get_offset_exponent(std::bit_cast<float>(bits));
+			return bits & ~fractional_mask(exponent);
+		}
+
+		[[nodiscard]] constexpr std::uint32_t round_bits(std::uint32_t bits) {
+			const std::int32_t exponent = float_parts::get_offset_exponent(std::bit_cast<float>(bits));
+			// Adding half of the last integer digit rounds away from zero, and may carry into the exponent. Values in
+			// [0.5, 1) are handled by clearing all fraction bits after the carry
+			const auto half_shift = static_cast<std::uint32_t>(std::clamp<std::int32_t>(exponent + 1, 0, 31));
+			const std::uint32_t half = exponent < -1 ? 0u : (1u << float_parts::num_fraction_bits) >> half_shift;
+			const std::uint32_t mask = exponent == -1 ? float_parts::fraction_mask : fractional_mask(exponent);
+			return (bits + half) & ~mask;
+		}
+
+		[[nodiscard]] constexpr std::uint32_t floor_bits(std::uint32_t bits) {
+			const std::int32_t exponent = float_parts::get_offset_exponent(std::bit_cast<float>(bits));
+			const std::uint32_t mask = fractional_mask(exponent);
+			const std::uint32_t truncated = bits & ~mask;
+			// Negative numbers with a fractional part have their magnitude incremented by one
+			const std::uint32_t increment =
+				(bits & float_parts::sign_mask) != 0 && (bits & mask) != 0 ? mask + 1 : 0u;
+			constexpr std::uint32_t negative_one = 0xBF800000u;
+			return exponent < 0 && increment != 0 ? negative_one : truncated + increment;
+		}
+
+		[[nodiscard]] constexpr std::uint32_t ceil_bits(std::uint32_t bits) {
+			return floor_bits(bits ^ float_parts::sign_mask) ^ float_parts::sign_mask;
+		}
+	}
+
+	namespace _details {
+		// Applies a function on bit patterns to all elements
+		template <std::uint32_t (*BitsFunc)(std::uint32_t)> struct bits_batch_kernel {
+			void operator()(std::span<const float> in, std::span<float> out) const {
+				for (std::size_t i = 0; i < in.size(); ++i) {
+					out[i] = std::bit_cast<float>(BitsFunc(std::bit_cast<std::uint32_t>(in[i])));
+				}
+			}
+		};
+	}
+
+	// Batch versions of the functions above, using the instruction set chosen by get_simd_level(). The input and
+	// output spans must have the same size
+
+	inline void trunc_batch(std::span<const float> in, std::span<float> out) {
+		_details::dispatch_kernel<_details::bits_batch_kernel<_details::trunc_bits>>(in, out);
+	}
+
+	inline void round_batch(std::span<const float> in, std::span<float> out) {
+		_details::dispatch_kernel<_details::bits_batch_kernel<_details::round_bits>>(in, out);
+	}
+
+	inline void floor_batch(std::span<const float> in, std::span<float> out) {
+		_details::dispatch_kernel<_details::bits_batch_kernel<_details::floor_bits>>(in, out);
+	}
+
+	inline void ceil_batch(std::span<const float> in, std::span<float> out) {
+		_details::dispatch_kernel<_details::bits_batch_kernel<_details::ceil_bits>>(in, out);
+	}
 }
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <cstdlib>
 #include <cfenv>
 #include <cmath>
+#include <limits>
 #include <random>
 
 #include "float_parts.h"
+#include "instrumentation.h"
 
 namespace float_utils {
 	enum class rounding_mode {
@@ -14,6 +18,9 @@ namespace float_utils {
 		nearest_tie_to_even,
 		nearest_tie_to_infinity,
 		toward_zero,
+		// Rounds the magnitude up with probability equal to the truncated fraction of an ulp, so that rounding is
+		// unbiased on average. Random bits are drawn from a per-thread stream, see seed_stochastic_rounding()
+		stochastic,
 
 		system
 	};
@@ -40,9 +47,13 @@ namespace float_utils {
 		case rounding_mode::nearest_tie_to_even:
 			[[fallthrough]];
 		case rounding_mode::nearest_tie_to_infinity:
+			[[fallthrough]];
+		case rounding_mode::stochastic: // No hardware equivalent, use the closest deterministic mode
 			return FE_TONEAREST;
 		case rounding_mode::toward_zero:
 			return FE_TOWARDZERO;
+		case rounding_mode::system:
+			break;
 		}
 		return FE_TOWARDZERO;
 	}
@@ -58,10 +69,24 @@ namespace float_utils {
 #endif
 	}
 
-	// Generates any valid floating point bit pattern with equal probability
+	// Generates any finite floating point bit pattern, including subnormals and zeros, with equal probability
 	template <typename Rng> constexpr float random_float(Rng &rng) {
 		using uniform_uint32 = std::uniform_int_distribution<std::uint32_t>;
 
+		uniform_uint32 exponent_dist(0u, (1u << float_parts::num_exponent_bits) - 2u);
+		uniform_uint32 fraction_dist(0u, float_parts::fraction_mask);
+		uniform_uint32 sign_dist(0u, 1u);
+
+		const std::uint32_t s = sign_dist(rng);
+		const std::uint32_t e = exponent_dist(rng);
+		const std::uint32_t f = fraction_dist(rng);
+
+		return float_parts::assemble(s != 0, e, f);
+	}
+	// Generates any normal floating point bit pattern with equal probability
+	template <typename Rng> constexpr float random_normal_float(Rng &rng) {
+		using uniform_uint32 = std::uniform_int_distribution<std::uint32_t>;
+
 		uniform_uint32 exponent_dist(1u, (1u << float_parts::num_exponent_bits) - 2u);
 		uniform_uint32 fraction_dist(0u, float_parts::fraction_mask);
 		uniform_uint32 sign_dist(0u, 1u);
@@ -73,67 +98,128 @@ namespace float_utils {
 		return float_parts::assemble(s != 0, e, f);
 	}
 
-	float round_result(
-		rounding_mode rounding,
-		bool rp, std::uint32_t re, std::uint32_t rf,
-		std::uint32_t truncated_bits, bool is_inf
-	) {
-		std::uint32_t rounding_inc = 0;
-		switch (rounding) {
-		case rounding_mode::downward:
-			if (rp) { // Result is negative
-				// Round up - increment if there are truncated bits, either from the result or from y if it has the
-				// same sign as x
-				if (truncated_bits) {
-					rounding_inc = 1;
-				}
-			} else { // !rp, result is positive
-				// Effectively round towards zero
-				if (is_inf) {
-					return std::numeric_limits<float>::max();
-				}
+	namespace _details {
+		// Shifts a normalized fraction right by the given number of bits to produce the fraction of a subnormal result,
+		// merging the bits that are shifted out into the truncated bits. Bits that fall off the end of the truncated
+		// bits are kept as a sticky bit so that rounding still sees them
+		constexpr void denormalize(std::uint32_t &rf, std::uint32_t &truncated_bits, std::uint32_t shift) {
+			// The fraction and the truncated bits are shifted together as one 64-bit value, so that the truncated bits
+			// keep their exact weight for stochastic rounding. Bits shifted out of the window are kept as a sticky bit
+			shift = std::min(shift, 63u);
+			const std::uint64_t value = (static_cast<std::uint64_t>(rf) << 32) | truncated_bits;
+			const std::uint32_t sticky = shift != 0 && (value << (64 - shift)) != 0 ? 1u : 0u;
+			const std::uint64_t shifted = value >> shift;
+			rf = static_cast<std::uint32_t>(shifted >> 32);
+			truncated_bits = static_cast<std::uint32_t>(shifted) | sticky;
+		}
+
+		// Shifts the fraction of a non-zero subnormal number left until its implicit bit is set, and returns the
+		// corresponding offset exponent
+		[[nodiscard]] constexpr std::int32_t normalize_subnormal(std::uint32_t &f) {
+			const auto shift = static_cast<std::uint32_t>(std::countl_zero(f)) - (31 - float_parts::num_fraction_bits);
+			f <<= shift;
+			return 1 - static_cast<std::int32_t>(float_parts::exponent_offset + shift);
+		}
+	}
+
+	namespace _details {
+		// Random stream used by stochastic rounding. Each draw hashes a per-thread counter using the SplitMix64
+		// finalizer, so draws are cheap and the stream is reproducible after seeding
+		class stochastic_rounding_stream {
+		public:
+			constexpr static std::uint64_t default_seed = 0x853c49e6748fea9bull;
+			constexpr static std::uint64_t increment = 0x9e3779b97f4a7c15ull;
+
+			// Returns the state of the current thread. Every thread starts from the default seed
+			[[nodiscard]] static std::uint64_t &get_state() {
+				thread_local std::uint64_t state = default_seed;
+				return state;
 			}
-			break;
-		case rounding_mode::upward:
-			// Same as rounding_mode::downward, but with signs flipped
-			if (!rp) {
-				if (truncated_bits) {
-					rounding_inc = 1;
-				}
-			} else { // rp
-				if (is_inf) {
-					return -std::numeric_limits<float>::max();
-				}
+			// Returns the random bits that follow the given state
+			[[nodiscard]] constexpr static std::uint32_t mix(std::uint64_t state) {
+				state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9ull;
+				state = (state ^ (state >> 27)) * 0x94d049bb133111ebull;
+				return static_cast<std::uint32_t>((state ^ (state >> 31)) >> 32);
 			}
-			break;
-		case rounding_mode::nearest_tie_to_even:
-			[[fallthrough]];
-		case rounding_mode::nearest_tie_to_infinity:
-			{
+			// Advances the stream of the current thread and returns 32 random bits
+			[[nodiscard]] static std::uint32_t next() {
+				std::uint64_t &state = get_state();
+				state += increment;
+				return mix(state);
+			}
+		};
+	}
+
+	// Seeds the stochastic rounding stream of the current thread. Results of stochastic rounding are reproducible
+	// given the seed and the sequence of operations performed by the thread. Threads that should produce independent
+	// results need different seeds
+	inline void seed_stochastic_rounding(std::uint64_t seed) {
+		_details::stochastic_rounding_stream::get_state() = seed;
+	}
+
+	namespace _details {
+		// Returns 1 if a value with the given sign, least significant bit and truncated bits should have its magnitude
+		// incremented when rounding, and 0 otherwise. The most significant truncated bit has half the weight of the
+		// least significant bit
+		[[nodiscard]] constexpr std::uint32_t rounding_increment(
+			rounding_mode rounding, bool negative, bool lsb, std::uint32_t truncated_bits
+		) {
+			switch (rounding) {
+			case rounding_mode::downward:
+				// Round up negative numbers - increment if there are truncated bits. The conditions are combined without
+				// short-circuiting so that batch kernels can be vectorized
+				return (negative ? 1u : 0u) & (truncated_bits != 0 ? 1u : 0u);
+			case rounding_mode::upward:
+				// Same as rounding_mode::downward, but with signs flipped
+				return (negative ? 0u : 1u) & (truncated_bits != 0 ? 1u : 0u);
+			case rounding_mode::nearest_tie_to_even:
 				if (truncated_bits == 0x80000000u) {
-					if (rounding == rounding_mode::nearest_tie_to_even) {
-						rounding_inc = (rf & 1u) ? 1u : 0u;
-					} else {
-						rounding_inc = 1; // Not verified - no hardware implementation
-					}
-				} else {
-					rounding_inc = (truncated_bits & 0x80000000u) ? 1 : 0;
+					return lsb ? 1u : 0u;
 				}
+				return (truncated_bits & 0x80000000u) ? 1u : 0u;
+			case rounding_mode::nearest_tie_to_infinity:
+				// Not verified for floating point results - no hardware implementation
+				return (truncated_bits & 0x80000000u) ? 1u : 0u;
+			case rounding_mode::stochastic:
+				// A uniform 32-bit value is below the truncated bits with probability truncated_bits / 2^32. Exact
+				// results do not consume random bits. Cannot be evaluated at compile time
+				return truncated_bits != 0 && stochastic_rounding_stream::next() < truncated_bits ? 1u : 0u;
+			case rounding_mode::toward_zero:
+				[[fallthrough]];
+			case rounding_mode::system:
+				break;
 			}
-			break;
-		case rounding_mode::toward_zero:
-			// Truncate inf to maximum non-inf value, but otherwise nothing to do
-			if (is_inf) {
+			return 0;
+		}
+	}
+
+	template <typename Instrumentation = no_instrumentation> constexpr float round_result(
+		rounding_mode rounding,
+		bool rp, std::uint32_t re, std::uint32_t rf,
+		std::uint32_t truncated_bits, bool is_inf
+	) {
+		if (is_inf) {
+			Instrumentation::hit(operator_path::round_overflow);
+			// Rounding towards zero truncates inf to the maximum non-inf value
+			const bool to_max =
+				rounding == rounding_mode::toward_zero ||
+				(rounding == rounding_mode::downward && !rp) ||
+				(rounding == rounding_mode::upward && rp);
+			if (to_max) {
+				Instrumentation::hit(operator_path::round_overflow_to_max);
 				constexpr float maxv = std::numeric_limits<float>::max();
 				return rp ? -maxv : maxv;
 			}
-			break;
+			// Handle proper inf by zeroing the fraction
+			return std::bit_cast<float>(float_parts::assemble_bits(rp, re, 0));
 		}
 
-		// Handle proper inf by zeroing the fraction
-		if (is_inf) {
-			rf = 0;
-			rounding_inc = 0;
+		const std::uint32_t rounding_inc = _details::rounding_increment(rounding, rp, rf & 1u, truncated_bits);
+		if (truncated_bits == 0x80000000u) {
+			Instrumentation::hit(operator_path::round_tie);
+		}
+		if (rounding_inc != 0) {
+			Instrumentation::hit(operator_path::round_increment);
 		}
 		return std::bit_cast<float>(float_parts::assemble_bits(rp, re, rf) + rounding_inc);
 	}
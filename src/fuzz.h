@@ -1,27 +1,77 @@
 #pragma once
 
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <functional>
+#include <limits>
 #include <random>
+#include <sstream>
 #include <string_view>
 
+#include "float_utils/decimal.h"
+#include "float_utils/instrumentation.h"
 #include "float_utils/utils.h"
+#include "fuzz_inputs.h"
+#include "shard.h"
+#include "telemetry.h"
+#include "triage.h"
 
-void fuzz_binary_float_operator(
+// Bitwise comparison of two floats, usable in constant expressions
+[[nodiscard]] constexpr bool bitwise_equal(float x, float y) {
+	return std::bit_cast<std::uint32_t>(x) == std::bit_cast<std::uint32_t>(y);
+}
+
+// Fuzzes the operator using inputs from all input classes, favoring classes that hit rarely covered targets or take
+// rarely taken paths of the software implementation, which should be instrumented using float_utils::path_counters.
+// Runs the iterations selected by the shard spec, or forever if the spec has no iteration count. Results are written to
+// the output file of the spec after every progress report and when finished. Only the first few mismatches are printed
+// in full; all of them are triaged, and the clusters are reported with the progress
+shard_result fuzz_binary_float_operator(
+	fuzz_operator op,
 	std::function<float(float, float)> sys_ver,
 	std::function<float(float, float)> my_ver,
-	std::string_view test_name
+	std::string_view test_name,
+	std::string_view mode_name,
+	const shard_spec &spec
 ) {
-	std::uint32_t valid_tests = 0;
-	std::uint32_t finite_tests = 0;
+	constexpr std::uint64_t report_interval = 100000000;
+	constexpr std::uint64_t max_printed_mismatches = 16;
+
+	shard_result result;
+	result.test = test_name;
+	result.mode = mode_name;
+	result.total = spec.iterations.value_or(0);
+	result.seed = spec.seed;
+	std::tie(result.begin, result.end) = spec.get_range(spec.iterations.value_or(std::numeric_limits<std::uint64_t>::max()));
+
+	telemetry_task &task = telemetry::begin_task(result);
+	telemetry_counters &counters = task.add_thread();
 
-	auto test = [&](float x, float y) -> bool {
+	std::uint64_t valid_tests = 0;
+	std::uint64_t finite_tests = 0;
+	coverage_guided_sampler sampler;
+	mismatch_triage triage(my_ver, sys_ver);
+	// Paths counted while shrinking mismatches, which are excluded from the paths taken by fuzzed inputs
+	float_utils::path_counters::counters triage_paths{};
+
+	auto test = [&](float x, float y, input_class cls) -> bool {
 		const float hw_res = sys_ver(x, y);
+		const float_utils::path_counters::counters before = float_utils::path_counters::snapshot();
 		const float my_res = my_ver(x, y);
+		const float_utils::path_counters::counters after = float_utils::path_counters::snapshot();
+		std::uint32_t paths = 0;
+		for (std::size_t p = 0; p < float_utils::num_operator_paths; ++p) {
+			if (after[p] != before[p]) {
+				paths |= 1u << p;
+			}
+		}
+		sampler.record(cls, classify_coverage(op, x, y, hw_res), paths);
 
 		const auto hw_bin = std::bit_cast<std::uint32_t>(hw_res);
 		const auto my_bin = std::bit_cast<std::uint32_t>(my_res);
-		if (hw_bin == my_bin) {
+		// The bit patterns of NaNs produced by hardware are platform-dependent
+		if (hw_bin == my_bin || (std::isnan(hw_res) && std::isnan(my_res))) {
 			++valid_tests;
 			if (std::isfinite(hw_res)) {
 				++finite_tests;
@@ -29,40 +79,121 @@ void fuzz_binary_float_operator(
 			return true;
 		}
 
-		// Filter out denorm
-		const std::uint32_t he = float_parts::get_exponent(hw_res);
-		if (he == 0) {
-			return true;
+		const float_utils::path_counters::counters before_triage = float_utils::path_counters::snapshot();
+		triage.add(x, y, hw_res, my_res, paths);
+		const float_utils::path_counters::counters after_triage = float_utils::path_counters::snapshot();
+		for (std::size_t p = 0; p < float_utils::num_operator_paths; ++p) {
+			triage_paths[p] += after_triage[p] - before_triage[p];
 		}
-
-		std::cout <<
-			"Hardware " << test_name << ": " << std::hex << hw_bin << std::dec << "  " << std::hexfloat << hw_res << "\n" <<
-			"      My " << test_name << ": " << std::hex << my_bin << std::dec << "  " << std::hexfloat << my_res << "\n";
+		if (result.num_failed < max_printed_mismatches) {
+			std::cout <<
+				"Hardware " << test_name << ": " << std::hex << hw_bin << std::dec << "  " <<
+				std::hexfloat << hw_res << std::defaultfloat << "  " << float_utils::to_string(hw_res) << "\n" <<
+				"      My " << test_name << ": " << std::hex << my_bin << std::dec << "  " <<
+				std::hexfloat << my_res << std::defaultfloat << "  " << float_utils::to_string(my_res) << "\n";
+		}
+		std::ostringstream failure;
+		failure <<
+			std::hex << std::bit_cast<std::uint32_t>(x) << " " << std::bit_cast<std::uint32_t>(y) << " " <<
+			hw_bin << " " << my_bin;
+		result.add_failure(failure.str());
+		counters.add_mismatch();
 
 		return false;
 	};
 
 	std::cout <<
-		"Starting fuzz test for " << test_name << "()\n" <<
+		"Starting fuzz test for " << test_name << "(), rounding mode " << mode_name << "\n" <<
 		"---------\n";
 
-	std::default_random_engine rng(12345);
-	for (std::uint32_t i = 1; ; ++i) {
-		const float x = float_utils::random_float(rng);
-		const float y = float_utils::random_float(rng);
+	// Each shard uses a different random sequence so that shards test different inputs
+	std::seed_seq seed_seq{
+		static_cast<std::uint32_t>(spec.seed), static_cast<std::uint32_t>(spec.seed >> 32),
+		static_cast<std::uint32_t>(result.begin), static_cast<std::uint32_t>(result.begin >> 32)
+	};
+	std::default_random_engine rng(seed_seq);
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t iter = result.begin; iter < result.end; ++iter) {
+		const input_class cls = sampler.next_class(rng);
+		const auto [x, y] = generate_fuzz_inputs(rng, op, cls);
 
-		if (!test(x, y)) {
+		if (!test(x, y, cls) && result.num_failed <= max_printed_mismatches) {
 			std::cout <<
-				"Iter " << i << ": " << x << " + " << y << "\n" <<
+				"Iter " << iter << ": " << x << ", " << y << "\n" <<
 				"----------\n";
 		}
 
-		if (i % 100000000 == 0) {
+		const std::uint64_t i = iter - result.begin + 1;
+		result.num_tested = i;
+		counters.add_samples(1);
+		if (i % report_interval == 0 || iter + 1 == result.end) {
+			const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+			result.seconds = duration.count();
+			write_shard_results(spec.output, { result });
+
 			std::cout <<
-				"Iter " << i << "\n" <<
+				"Iter " << iter + 1 << "\n" <<
 				"Valid tests: " << 100.0f * valid_tests / static_cast<float>(i) << "%\n" <<
 				"Tests producing finite numbers: " << 100.0f * finite_tests / static_cast<float>(i) << "%\n" <<
-				"----------\n";
+				"Coverage (hits, first hit):\n";
+			for (std::size_t t = 0; t < num_coverage_targets; ++t) {
+				const auto target = static_cast<coverage_target>(t);
+				std::cout <<
+					"  " << get_coverage_target_name(target) << ": " <<
+					sampler.get_total_hits(target) << ", " << sampler.get_first_hit(target) << "\n";
+			}
+			std::cout << "Input class weights:";
+			for (std::size_t c = 0; c < num_input_classes; ++c) {
+				std::cout << " " << sampler.get_weight(static_cast<input_class>(c));
+			}
+			std::cout << "\nPaths taken by my " << test_name << ":\n";
+			float_utils::path_counters::counters fuzzed_paths = float_utils::path_counters::snapshot();
+			for (std::size_t p = 0; p < float_utils::num_operator_paths; ++p) {
+				fuzzed_paths[p] -= triage_paths[p];
+			}
+			float_utils::path_counters::write_report(std::cout, fuzzed_paths, test_name);
+			if (triage.get_num_mismatches() > 0) {
+				triage.write_report(std::cout, test_name, mode_name);
+			}
+			std::cout << "----------\n";
 		}
 	}
+	task.finish();
+	return result;
+}
+
+// Entry point shared by the fuzz executables. Parses the shard spec, and fuzzes the operator using the rounding mode
+// from the spec, or rounding to nearest with ties to even if the spec has none. MyOp is a templated function object
+// that returns the software implementation for a rounding mode
+template <typename MyOp> int fuzz_main(
+	int argc, char **argv,
+	fuzz_operator op, std::function<float(float, float)> sys_ver, MyOp &&my_ver, std::string_view test_name
+) {
+	const std::optional<shard_spec> spec = parse_shard_spec(argc, argv);
+	if (!spec) {
+		return 1;
+	}
+	const float_utils::rounding_mode mode = spec->mode.value_or(float_utils::rounding_mode::nearest_tie_to_even);
+	if (mode == float_utils::rounding_mode::nearest_tie_to_infinity) {
+		std::cerr << "There is no hardware implementation of rounding to nearest with ties to infinity\n";
+		return 1;
+	}
+	if (mode == float_utils::rounding_mode::stochastic) {
+		std::cerr << "There is no hardware implementation of stochastic rounding, use exec_stochastic instead\n";
+		return 1;
+	}
+	// Without a total, shards of an unbounded campaign cannot be checked for coverage when merged
+	if ((spec->range || spec->count > 1) && !spec->iterations) {
+		std::cerr << "Sharded fuzz tests require --iterations\n";
+		return 1;
+	}
+
+	const telemetry_reporter reporter(spec.value());
+	std::fesetround(float_utils::to_fe_rounding_mode(mode));
+	const shard_result result = dispatch_rounding_mode(mode, [&]<float_utils::rounding_mode Mode>() {
+		return fuzz_binary_float_operator(
+			op, sys_ver, my_ver.template operator()<Mode>(), test_name, get_rounding_mode_name(mode), spec.value()
+		);
+	});
+	return result.num_failed == 0 ? 0 : 1;
 }
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <utility>
+
+#include "float_utils/category.h"
+#include "float_utils/float_parts.h"
+#include "float_utils/instrumentation.h"
+#include "float_utils/utils.h"
+
+// The operator being fuzzed, used to target inputs at its corner cases
+enum class fuzz_operator {
+	add,
+	mul,
+	div
+};
+
+// Classes of inputs, each generated to exercise a different set of paths
+enum class input_class : std::uint32_t {
+	uniform, // Any finite floats
+	exponent_difference, // Exponents that differ by up to a few bits more than the fraction width
+	cancellation, // y is close to -x
+	tie, // The exact result lies halfway between two floats
+	overflow, // The result is close to the largest finite value
+	subnormal, // The result is close to or in the subnormal range
+
+	count
+};
+constexpr std::size_t num_input_classes = static_cast<std::size_t>(input_class::count);
+
+// Corner cases that the fuzzer tries to cover, identified from the inputs and the hardware result
+enum class coverage_target : std::uint32_t {
+	exact, // No rounding is necessary
+	inexact, // The result is rounded
+	tie, // The exact result is halfway between two floats
+	shift_near_mantissa, // The exponents differ by roughly the number of fraction bits (add only)
+	carry, // The result has a larger exponent than both operands (add only)
+	cancellation, // The result has a much smaller exponent than the larger operand (add only)
+	zero, // Non-zero operands produce a zero result
+	overflow, // Finite operands produce an infinite result
+	subnormal, // The result is subnormal
+
+	count
+};
+constexpr std::size_t num_coverage_targets = static_cast<std::size_t>(coverage_target::count);
+
+[[nodiscard]] constexpr std::string_view get_coverage_target_name(coverage_target target) {
+	constexpr std::array<std::string_view, num_coverage_targets> names{
+		"exact", "inexact", "tie", "shift_near_mantissa", "carry", "cancellation", "zero", "overflow", "subnormal"
+	};
+	return names[static_cast<std::size_t>(target)];
+}
+
+namespace fuzz::_details {
+	constexpr std::uint32_t max_finite_exponent = (1u << float_parts::num_exponent_bits) - 2;
+
+	[[nodiscard]] constexpr std::uint32_t clamp_exponent(std::int32_t exponent) {
+		return static_cast<std::uint32_t>(std::clamp<std::int32_t>(exponent, 0, max_finite_exponent));
+	}
+
+	template <typename Rng> [[nodiscard]] float random_float_with_exponent(Rng &rng, std::uint32_t exponent) {
+		std::uniform_int_distribution<std::uint32_t> fraction_dist(0u, float_parts::fraction_mask);
+		std::uniform_int_distribution<std::uint32_t> sign_dist(0u, 1u);
+		return float_parts::assemble(sign_dist(rng) != 0, exponent, fraction_dist(rng));
+	}
+
+	// Generates a pair of inputs whose result has roughly the given biased exponent
+	template <typename Rng> [[nodiscard]] std::pair<float, float> random_floats_with_result_exponent(
+		Rng &rng, fuzz_operator op, std::int32_t result_exponent
+	) {
+		constexpr auto offset = static_cast<std::int32_t>(float_parts::exponent_offset);
+		if (op == fuzz_operator::add) {
+			// Both operands need to be around the same magnitude as the result
+			std::uniform_int_distribution<std::int32_t> diff_dist(0, 3);
+			return {
+				random_float_with_exponent(rng, clamp_exponent(result_exponent)),
+				random_float_with_exponent(rng, clamp_exponent(result_exponent - diff_dist(rng)))
+			};
+		}
+
+		std::uniform_int_distribution<std::int32_t> exponent_dist(0, max_finite_exponent);
+		const std::int32_t xe = exponent_dist(rng);
+		std::int32_t ye = 0;
+		switch (op) {
+		case fuzz_operator::add:
+			break;
+		case fuzz_operator::mul:
+			ye = result_exponent - xe + offset;
+			break;
+		case fuzz_operator::div:
+			ye = xe - result_exponent + offset;
+			break;
+		}
+		return { random_float_with_exponent(rng, clamp_exponent(xe)), random_float_with_exponent(rng, clamp_exponent(ye)) };
+	}
+}
+
+// Generates a pair of inputs of the given class
+template <typename Rng> [[nodiscard]] std::pair<float, float> generate_fuzz_inputs(
+	Rng &rng, fuzz_operator op, input_class cls
+) {
+	using uniform_uint32 = std::uniform_int_distribution<std::uint32_t>;
+
+	switch (cls) {
+	case input_class::uniform:
+		break;
+	case input_class::exponent_difference:
+		{
+			const float x = float_utils::random_normal_float(rng);
+			uniform_uint32 diff_dist(0u, float_parts::num_fraction_bits + 3);
+			const auto ye = static_cast<std::int32_t>(float_parts::get_exponent(x) - diff_dist(rng));
+			return { x, fuzz::_details::random_float_with_exponent(rng, fuzz::_details::clamp_exponent(ye)) };
+		}
+	case input_class::cancellation:
+		{
+			// Negate x and perturb a random number of its lowest bits
+			const float x = float_utils::random_normal_float(rng);
+			uniform_uint32 bits_dist(0u, float_parts::num_fraction_bits + 1);
+			const std::uint32_t num_bits = bits_dist(rng);
+			uniform_uint32 offset_dist(0u, (1u << num_bits) - 1);
+			uniform_uint32 direction_dist(0u, 1u);
+			const std::uint32_t neg_x = std::bit_cast<std::uint32_t>(-x);
+			const std::uint32_t offset = offset_dist(rng);
+			const std::uint32_t y = direction_dist(rng) != 0 || offset > (neg_x & ~float_parts::sign_mask) ?
+				neg_x + offset : neg_x - offset;
+			if (float_utils::is_nan(std::bit_cast<float>(y)) || float_utils::is_inf(std::bit_cast<float>(y))) {
+				break;
+			}
+			return { x, std::bit_cast<float>(y) };
+		}
+	case input_class::tie:
+		switch (op) {
+		case fuzz_operator::add:
+			{
+				// y = (k + 1/2) ulp(x) for some k with a random number of bits
+				const float x = float_utils::random_normal_float(rng);
+				uniform_uint32 bits_dist(0u, float_parts::num_fraction_bits - 1);
+				uniform_uint32 k_dist(0u, (1u << bits_dist(rng)) - 1);
+				uniform_uint32 sign_dist(0u, 1u);
+				const std::uint32_t k2p1 = k_dist(rng) * 2 + 1;
+				// The exponent of the last fraction bit of x, minus 1 to get half of the ulp
+				const std::int32_t ulp_exponent =
+					float_parts::get_offset_exponent(x) - static_cast<std::int32_t>(float_parts::num_fraction_bits) - 1;
+				const float y = std::ldexp(static_cast<float>(k2p1), ulp_exponent);
+				return { x, sign_dist(rng) != 0 ? -y : y };
+			}
+		case fuzz_operator::mul:
+			{
+				// y = 2^n (1 + 2^-j), and the lowest j bits of x are 100...0 so that x * 2^-j ends with exactly half
+				// of the last fraction bit of x
+				uniform_uint32 j_dist(1u, float_parts::num_fraction_bits);
+				const std::uint32_t j = j_dist(rng);
+				const std::uint32_t x_bits = std::bit_cast<std::uint32_t>(float_utils::random_normal_float(rng));
+				const float x = std::bit_cast<float>((x_bits & ~((1u << j) - 1)) | (1u << (j - 1)));
+				uniform_uint32 exponent_dist(float_parts::exponent_offset - 8, float_parts::exponent_offset + 8);
+				const float y = float_parts::assemble(
+					x_bits & 1u, exponent_dist(rng), 1u << (float_parts::num_fraction_bits - j)
+				);
+				return { x, y };
+			}
+		case fuzz_operator::div:
+			// Division never produces exact ties; generate exact quotients instead, which have no remainder
+			{
+				const float y = float_utils::random_normal_float(rng);
+				uniform_uint32 quotient_dist(1u, 1u << 12);
+				const float x = y * static_cast<float>(quotient_dist(rng));
+				if (!std::isfinite(x)) {
+					break;
+				}
+				return { x, y };
+			}
+		}
+		break;
+	case input_class::overflow:
+		{
+			uniform_uint32 exponent_dist(fuzz::_details::max_finite_exponent - 2, fuzz::_details::max_finite_exponent + 1);
+			return fuzz::_details::random_floats_with_result_exponent(rng, op, exponent_dist(rng));
+		}
+	case input_class::subnormal:
+		{
+			std::uniform_int_distribution<std::int32_t> exponent_dist(
+				-static_cast<std::int32_t>(float_parts::num_fraction_bits) - 2, 2
+			);
+			return fuzz::_details::random_floats_with_result_exponent(rng, op, exponent_dist(rng));
+		}
+	case input_class::count:
+		break;
+	}
+	return { float_utils::random_float(rng), float_utils::random_float(rng) };
+}
+
+// Returns a bit mask of the coverage targets hit by the given inputs and hardware result
+[[nodiscard]] inline std::uint32_t classify_coverage(fuzz_operator op, float x, float y, float result) {
+	auto bit = [](coverage_target target) {
+		return 1u << static_cast<std::uint32_t>(target);
+	};
+
+	std::uint32_t targets = 0;
+	if (!std::isfinite(x) || !std::isfinite(y) || std::isnan(result)) {
+		return targets;
+	}
+
+	// Doubles hold exact sums as long as the exponents are close enough, and exact products. Quotients are rounded,
+	// but they are also never exactly halfway between two floats
+	double exact = 0.0;
+	switch (op) {
+	case fuzz_operator::add:
+		exact = static_cast<double>(x) + static_cast<double>(y);
+		break;
+	case fuzz_operator::mul:
+		exact = static_cast<double>(x) * static_cast<double>(y);
+		break;
+	case fuzz_operator::div:
+		exact = static_cast<double>(x) / static_cast<double>(y);
+		break;
+	}
+
+	if (std::isinf(result)) {
+		// The exact value is only infinite when dividing by zero
+		return std::isinf(exact) ? 0u : bit(coverage_target::overflow) | bit(coverage_target::inexact);
+	}
+	if (exact == static_cast<double>(result)) {
+		targets |= bit(coverage_target::exact);
+	} else {
+		targets |= bit(coverage_target::inexact);
+		// Check if the exact value lies exactly between the result and its neighbor
+		constexpr float inf = std::numeric_limits<float>::infinity();
+		const float neighbor = std::nextafter(result, exact > result ? inf : -inf);
+		if (std::isfinite(neighbor) && (static_cast<double>(result) + static_cast<double>(neighbor)) * 0.5 == exact) {
+			targets |= bit(coverage_target::tie);
+		}
+	}
+	if (result == 0.0f && x != 0.0f && (op == fuzz_operator::div || y != 0.0f)) {
+		targets |= bit(coverage_target::zero);
+	}
+	if (float_utils::is_subnormal(result)) {
+		targets |= bit(coverage_target::subnormal);
+	}
+
+	if (op == fuzz_operator::add) {
+		const auto xe = static_cast<std::int32_t>(float_parts::get_exponent(x));
+		const auto ye = static_cast<std::int32_t>(float_parts::get_exponent(y));
+		const auto re = static_cast<std::int32_t>(float_parts::get_exponent(result));
+		const std::int32_t exponent_diff = std::abs(xe - ye);
+		if (exponent_diff + 1 >= static_cast<std::int32_t>(float_parts::num_fraction_bits) &&
+			exponent_diff <= static_cast<std::int32_t>(float_parts::num_fraction_bits) + 2
+		) {
+			targets |= bit(coverage_target::shift_near_mantissa);
+		}
+		if (re > std::max(xe, ye)) {
+			targets |= bit(coverage_target::carry);
+		}
+		if (result != 0.0f && re + 1 < std::max(xe, ye)) {
+			targets |= bit(coverage_target::cancellation);
+		}
+	}
+	return targets;
+}
+
+// Chooses input classes with probabilities that favor classes hitting rarely covered targets, and classes that take
+// rarely taken paths of the software implementation
+class coverage_guided_sampler {
+public:
+	// Number of samples between updates of the class weights
+	constexpr static std::uint64_t update_interval = 1 << 16;
+	// Every class is always chosen with at least this fraction of its share under uniform weights
+	constexpr static double min_weight_fraction = 0.1;
+
+	coverage_guided_sampler() {
+		_weights.fill(1.0);
+		_first_hit.fill(0);
+		_distribution = std::discrete_distribution<std::uint32_t>(_weights.begin(), _weights.end());
+	}
+
+	template <typename Rng> [[nodiscard]] input_class next_class(Rng &rng) {
+		return static_cast<input_class>(_distribution(rng));
+	}
+
+	// Records the targets hit by a sample from the given class, and the paths it has taken. Bit i of paths is set if the
+	// operator path with index i has been taken
+	void record(input_class cls, std::uint32_t targets, std::uint32_t paths) {
+		const auto c = static_cast<std::size_t>(cls);
+		++_samples[c];
+		++_total_samples;
+		for (std::size_t t = 0; t < num_coverage_targets; ++t) {
+			if (targets & (1u << t)) {
+				++_hits[c][t];
+				if (_total_hits[t]++ == 0) {
+					_first_hit[t] = _total_samples;
+				}
+			}
+		}
+		for (std::size_t p = 0; p < float_utils::num_operator_paths; ++p) {
+			if (paths & (1u << p)) {
+				++_path_hits[c][p];
+				++_total_path_hits[p];
+			}
+		}
+		if (_total_samples % update_interval == 0) {
+			_update_weights();
+		}
+	}
+
+	[[nodiscard]] std::uint64_t get_total_hits(coverage_target target) const {
+		return _total_hits[static_cast<std::size_t>(target)];
+	}
+	// Returns the index of the sample that first hit the given target, starting from 1, or 0 if it hasn't been hit
+	[[nodiscard]] std::uint64_t get_first_hit(coverage_target target) const {
+		return _first_hit[static_cast<std::size_t>(target)];
+	}
+	[[nodiscard]] double get_weight(input_class cls) const {
+		return _weights[static_cast<std::size_t>(cls)];
+	}
+private:
+	std::array<std::array<std::uint64_t, num_coverage_targets>, num_input_classes> _hits{};
+	std::array<std::uint64_t, num_input_classes> _samples{};
+	std::array<std::uint64_t, num_coverage_targets> _total_hits{};
+	std::array<std::uint64_t, num_coverage_targets> _first_hit{};
+	std::array<std::array<std::uint64_t, float_utils::num_operator_paths>, num_input_classes> _path_hits{};
+	std::array<std::uint64_t, float_utils::num_operator_paths> _total_path_hits{};
+	std::uint64_t _total_samples = 0;
+	std::array<double, num_input_classes> _weights{};
+	std::discrete_distribution<std::uint32_t> _distribution;
+
+	// Scores each class by the rate at which it hits each target and takes each path, weighted by how rare the target or
+	// the path is
+	void _update_weights() {
+		double total_score = 0.0;
+		for (std::size_t c = 0; c < num_input_classes; ++c) {
+			double score = 0.0;
+			auto add_score = [&](std::uint64_t hits, std::uint64_t total_hits) {
+				const double hit_rate = static_cast<double>(hits + 1) / static_cast<double>(_samples[c] + 1);
+				score += hit_rate / static_cast<double>(total_hits + 1);
+			};
+			for (std::size_t t = 0; t < num_coverage_targets; ++t) {
+				add_score(_hits[c][t], _total_hits[t]);
+			}
+			// Paths that have never been taken, such as the paths of other operators, would favor all classes equally
+			for (std::size_t p = 0; p < float_utils::num_operator_paths; ++p) {
+				if (_total_path_hits[p] > 0) {
+					add_score(_path_hits[c][p], _total_path_hits[p]);
+				}
+			}
+			_weights[c] = score;
+			total_score += score;
+		}
+		const double min_weight = min_weight_fraction / static_cast<double>(num_input_classes);
+		for (double &w : _weights) {
+			w = std::max(w / total_score, min_weight);
+		}
+		_distribution = std::discrete_distribution<std::uint32_t>(_weights.begin(), _weights.end());
+	}
+};
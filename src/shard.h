@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "float_utils/utils.h"
+
+// Sharding support for the sweep and fuzz executables. Each executable accepts a shard spec on its command line, runs
+// the part of the campaign selected by it, and optionally writes a result file. Result files of all shards can then be
+// combined into one report using exec_merge
+
+constexpr std::array<std::pair<std::string_view, float_utils::rounding_mode>, 6> rounding_mode_names{
+	std::pair<std::string_view, float_utils::rounding_mode>("downward", float_utils::rounding_mode::downward),
+	std::pair<std::string_view, float_utils::rounding_mode>("upward", float_utils::rounding_mode::upward),
+	std::pair<std::string_view, float_utils::rounding_mode>(
+		"nearest_tie_to_even", float_utils::rounding_mode::nearest_tie_to_even
+	),
+	std::pair<std::string_view, float_utils::rounding_mode>(
+		"nearest_tie_to_infinity", float_utils::rounding_mode::nearest_tie_to_infinity
+	),
+	std::pair<std::string_view, float_utils::rounding_mode>("toward_zero", float_utils::rounding_mode::toward_zero),
+	std::pair<std::string_view, float_utils::rounding_mode>("stochastic", float_utils::rounding_mode::stochastic)
+};
+
+[[nodiscard]] constexpr std::string_view get_rounding_mode_name(float_utils::rounding_mode mode) {
+	for (const auto &[name, value] : rounding_mode_names) {
+		if (value == mode) {
+			return name;
+		}
+	}
+	return "system";
+}
+[[nodiscard]] constexpr std::optional<float_utils::rounding_mode> parse_rounding_mode(std::string_view name) {
+	for (const auto &[mode_name, value] : rounding_mode_names) {
+		if (mode_name == name) {
+			return value;
+		}
+	}
+	return std::nullopt;
+}
+
+// Calls the templated function object with the given rounding mode as its template argument
+template <typename Func> decltype(auto) dispatch_rounding_mode(float_utils::rounding_mode mode, Func &&func) {
+	using enum float_utils::rounding_mode;
+	switch (mode) {
+	case downward:
+		return func.template operator()<downward>();
+	case upward:
+		return func.template operator()<upward>();
+	case nearest_tie_to_even:
+		return func.template operator()<nearest_tie_to_even>();
+	case nearest_tie_to_infinity:
+		return func.template operator()<nearest_tie_to_infinity>();
+	case toward_zero:
+		return func.template operator()<toward_zero>();
+	case stochastic:
+		return func.template operator()<stochastic>();
+	case system:
+		break;
+	}
+	return func.template operator()<system>();
+}
+
+// Selects a part of a test campaign. Fields that are not applicable to an executable are ignored by it
+struct shard_spec {
+	std::optional<std::pair<std::uint64_t, std::uint64_t>> range; // Explicit range, overrides the index and count
+	std::uint64_t index = 0; // Index of this shard when splitting evenly
+	std::uint64_t count = 1; // Total number of shards when splitting evenly
+	std::optional<std::uint64_t> iterations; // Total number of iterations for fuzz tests, which otherwise run forever
+	std::string op; // Only run the test with this name; empty to run all tests
+	std::optional<float_utils::rounding_mode> mode; // Only run tests with this rounding mode
+	std::uint64_t seed = 12345; // Seed for random inputs
+	std::string output; // File to write results to; empty to not write results
+	std::string metrics; // File to write live telemetry metrics to; empty to only print progress
+	double metrics_interval = 10.0; // Seconds between telemetry reports
+
+	// Returns the part of [0, total) covered by this shard
+	[[nodiscard]] std::pair<std::uint64_t, std::uint64_t> get_range(std::uint64_t total) const {
+		if (range) {
+			return { std::min(range->first, total), std::min(range->second, total) };
+		}
+		// Computed in two parts to avoid overflowing when the total is large
+		auto split = [&](std::uint64_t i) {
+			return total / count * i + total % count * i / count;
+		};
+		return { split(index), split(index + 1) };
+	}
+	[[nodiscard]] bool selects_op(std::string_view name) const {
+		return op.empty() || op == name;
+	}
+	[[nodiscard]] bool selects_mode(float_utils::rounding_mode m) const {
+		return !mode || mode.value() == m;
+	}
+};
+
+// Parses the shard spec from command line arguments. Prints the usage and returns std::nullopt on failure
+[[nodiscard]] inline std::optional<shard_spec> parse_shard_spec(int argc, char **argv) {
+	auto print_usage = [&]() {
+		std::cerr <<
+			"Usage: " << (argc > 0 ? argv[0] : "exec") << " [options]\n"
+			"  --shard I/N        Run the I-th of N equal parts of the campaign, starting from 0\n"
+			"  --range BEGIN:END  Run the given part of the campaign, overriding --shard\n"
+			"  --iterations N     Total number of iterations of fuzz tests, which otherwise run forever\n"
+			"  --op NAME          Only run the test with the given name\n"
+			"  --mode MODE        Only run tests with the given rounding mode: downward, upward, nearest_tie_to_even,\n"
+			"                     nearest_tie_to_infinity, or toward_zero\n"
+			"  --seed N           Seed for random inputs\n"
+			"  --output FILE      Write results to the given file, which can be combined with others using exec_merge\n"
+			"  --metrics FILE     Periodically write progress metrics to the given file in the Prometheus text format\n"
+			"  --metrics-interval SECONDS\n"
+			"                     Seconds between progress reports, 10 by default\n";
+	};
+	auto parse_uint = [](std::string_view str) -> std::optional<std::uint64_t> {
+		try {
+			std::size_t length = 0;
+			const std::uint64_t value = std::stoull(std::string(str), &length, 0);
+			if (length != str.size()) {
+				return std::nullopt;
+			}
+			return value;
+		} catch (...) {
+			return std::nullopt;
+		}
+	};
+	auto parse_positive_double = [](std::string_view str) -> std::optional<double> {
+		try {
+			std::size_t length = 0;
+			const double value = std::stod(std::string(str), &length);
+			if (length != str.size() || !(value > 0.0)) {
+				return std::nullopt;
+			}
+			return value;
+		} catch (...) {
+			return std::nullopt;
+		}
+	};
+	auto parse_pair = [&](std::string_view str, char separator) -> std::optional<std::pair<std::uint64_t, std::uint64_t>> {
+		const std::size_t pos = str.find(separator);
+		if (pos == std::string_view::npos) {
+			return std::nullopt;
+		}
+		const std::optional<std::uint64_t> first = parse_uint(str.substr(0, pos));
+		const std::optional<std::uint64_t> second = parse_uint(str.substr(pos + 1));
+		if (!first || !second) {
+			return std::nullopt;
+		}
+		return std::pair(first.value(), second.value());
+	};
+
+	shard_spec spec;
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+		if (arg == "--help" || arg == "-h") {
+			print_usage();
+			return std::nullopt;
+		}
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << "\n";
+			print_usage();
+			return std::nullopt;
+		}
+		const std::string_view value = argv[++i];
+
+		bool valid = true;
+		if (arg == "--shard") {
+			const auto index_count = parse_pair(value, '/');
+			valid = index_count && index_count->first < index_count->second;
+			if (valid) {
+				std::tie(spec.index, spec.count) = index_count.value();
+			}
+		} else if (arg == "--range") {
+			spec.range = parse_pair(value, ':');
+			valid = spec.range && spec.range->first <= spec.range->second;
+		} else if (arg == "--iterations") {
+			spec.iterations = parse_uint(value);
+			valid = spec.iterations.has_value();
+		} else if (arg == "--op") {
+			spec.op = value;
+		} else if (arg == "--mode") {
+			spec.mode = parse_rounding_mode(value);
+			valid = spec.mode.has_value();
+		} else if (arg == "--seed") {
+			const std::optional<std::uint64_t> seed = parse_uint(value);
+			valid = seed.has_value();
+			spec.seed = seed.value_or(0);
+		} else if (arg == "--output") {
+			spec.output = value;
+		} else if (arg == "--metrics") {
+			spec.metrics = value;
+		} else if (arg == "--metrics-interval") {
+			const std::optional<double> interval = parse_positive_double(value);
+			valid = interval.has_value();
+			spec.metrics_interval = interval.value_or(0.0);
+		} else {
+			std::cerr << "Unknown option: " << arg << "\n";
+			print_usage();
+			return std::nullopt;
+		}
+		if (!valid) {
+			std::cerr << "Invalid value for " << arg << ": " << value << "\n";
+			print_usage();
+			return std::nullopt;
+		}
+	}
+	return spec;
+}
+
+
+// Result of running one test on one shard
+struct shard_result {
+	// Only this many failures are recorded; the rest are only counted
+	constexpr static std::size_t max_recorded_failures = 64;
+	// Only this many failures are printed by record_failure()
+	constexpr static std::size_t max_printed_failures = 16;
+
+	std::string test; // Name of the test, without spaces
+	std::string mode = "none"; // Name of the rounding mode, or "none" if the test has no rounding mode
+	std::uint64_t begin = 0; // Range of inputs covered by this shard
+	std::uint64_t end = 0;
+	std::uint64_t total = 0; // Size of the full campaign, or 0 if it is unbounded
+	std::uint64_t seed = 0;
+	std::uint64_t num_tested = 0;
+	std::uint64_t num_failed = 0;
+	double seconds = 0.0;
+	std::vector<std::string> failures; // Descriptions of failed inputs, each on a single line
+
+	void add_failure(std::string description) {
+		++num_failed;
+		if (failures.size() < max_recorded_failures) {
+			failures.emplace_back(std::move(description));
+		}
+	}
+};
+
+// Creates the result of a test that covers the part of [0, total) selected by the shard spec
+[[nodiscard]] inline shard_result create_result(
+	const shard_spec &spec, std::string name, std::string mode, std::uint64_t total
+) {
+	shard_result result;
+	result.test = std::move(name);
+	result.mode = std::move(mode);
+	result.total = total;
+	result.seed = spec.seed;
+	std::tie(result.begin, result.end) = spec.get_range(total);
+	result.num_tested = result.end - result.begin;
+	return result;
+}
+
+// Adds a failure to the result, and prints it if it is one of the first few
+inline void record_failure(shard_result &result, std::string failure) {
+	if (result.num_failed < shard_result::max_printed_failures) {
+		std::cout << "Failure in " << result.test << " (" << result.mode << "): " << failure << "\n";
+	}
+	result.add_failure(std::move(failure));
+}
+
+// Bitwise comparison of two results, with all NaNs considered to be equal
+[[nodiscard]] inline bool same_result(float x, float y) {
+	return std::bit_cast<std::uint32_t>(x) == std::bit_cast<std::uint32_t>(y) || (std::isnan(x) && std::isnan(y));
+}
+
+// Writes all results to the file, replacing its contents. Does nothing if the path is empty. Results are written as
+// lines of space-separated fields:
+//   result <test> <mode> <begin> <end> <total> <seed> <tested> <failed> <seconds>
+//   failure <description>
+// where each failure line belongs to the last result line before it
+inline void write_shard_results(const std::string &path, const std::vector<shard_result> &results) {
+	if (path.empty()) {
+		return;
+	}
+	std::ofstream fout(path);
+	for (const shard_result &result : results) {
+		fout <<
+			"result " << result.test << " " << result.mode << " " <<
+			result.begin << " " << result.end << " " << result.total << " " << result.seed << " " <<
+			result.num_tested << " " << result.num_failed << " " << result.seconds << "\n";
+		for (const std::string &failure : result.failures) {
+			fout << "failure " << failure << "\n";
+		}
+	}
+	if (!fout) {
+		std::cerr << "Failed to write results to " << path << "\n";
+	}
+}
+
+// Reads results written by write_shard_results(). Returns std::nullopt if the file cannot be read or is malformed
+[[nodiscard]] inline std::optional<std::vector<shard_result>> read_shard_results(const std::string &path) {
+	std::ifstream fin(path);
+	if (!fin) {
+		return std::nullopt;
+	}
+	std::vector<shard_result> results;
+	for (std::string line; std::getline(fin, line); ) {
+		std::istringstream line_in(line);
+		std::string kind;
+		line_in >> kind;
+		if (kind == "result") {
+			shard_result &result = results.emplace_back();
+			line_in >>
+				result.test >> result.mode >> result.begin >> result.end >> result.total >> result.seed >>
+				result.num_tested >> result.num_failed >> result.seconds;
+			if (!line_in) {
+				return std::nullopt;
+			}
+		} else if (kind == "failure") {
+			if (results.empty()) {
+				return std::nullopt;
+			}
+			std::string description;
+			std::getline(line_in >> std::ws, description);
+			results.back().failures.emplace_back(std::move(description));
+		} else if (!kind.empty()) {
+			return std::nullopt;
+		}
+	}
+	return results;
+}
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "shard.h"
+
+// Live progress telemetry for the sweep and fuzz executables. Each worker thread counts its samples and mismatches in
+// counters that only it writes, and a reporter thread samples all counters periodically. The reporter prints one
+// progress line per running task, and optionally writes all metrics to a file in the Prometheus text format
+
+// Counters of one worker thread of a task. Only the owning thread writes them, so an increment is a relaxed load and
+// store without any locked instruction. Each set of counters has its own cache line so that workers never share one
+struct alignas(64) telemetry_counters {
+	std::atomic<std::uint64_t> samples = 0;
+	std::atomic<std::uint64_t> mismatches = 0;
+
+	void add_samples(std::uint64_t count) {
+		samples.store(samples.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+	}
+	void add_mismatch() {
+		add_mismatches(1);
+	}
+	void add_mismatches(std::uint64_t count) {
+		mismatches.store(mismatches.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+	}
+};
+
+// One test of a run, identified by its operator and rounding mode
+class telemetry_task {
+public:
+	using clock = std::chrono::steady_clock;
+
+	// The total is the number of samples this process will test, or 0 if the task is unbounded
+	telemetry_task(std::string op, std::string mode, std::uint64_t total) :
+		_op(std::move(op)), _mode(std::move(mode)), _total(total), _start(clock::now()) {
+	}
+
+	// Returns the counters of a new worker thread. The counters stay valid until the program exits
+	[[nodiscard]] telemetry_counters &add_thread() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _threads.emplace_back();
+	}
+	// Marks the task as finished, so that it is no longer reported as running
+	void finish() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_finish) {
+			_finish = clock::now();
+		}
+	}
+
+	// Values of all counters of the task at one point in time
+	struct snapshot {
+		std::vector<std::uint64_t> thread_samples;
+		std::uint64_t samples = 0;
+		std::uint64_t mismatches = 0;
+		double seconds = 0.0; // Time since the task started, up to when it finished
+		bool running = true;
+	};
+	[[nodiscard]] snapshot take_snapshot() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		snapshot result;
+		for (const telemetry_counters &counters : _threads) {
+			const std::uint64_t samples = counters.samples.load(std::memory_order_relaxed);
+			result.thread_samples.emplace_back(samples);
+			result.samples += samples;
+			result.mismatches += counters.mismatches.load(std::memory_order_relaxed);
+		}
+		result.running = !_finish.has_value();
+		const std::chrono::duration<double> duration = _finish.value_or(clock::now()) - _start;
+		result.seconds = duration.count();
+		return result;
+	}
+
+	[[nodiscard]] const std::string &get_op() const {
+		return _op;
+	}
+	[[nodiscard]] const std::string &get_mode() const {
+		return _mode;
+	}
+	[[nodiscard]] std::uint64_t get_total() const {
+		return _total;
+	}
+	[[nodiscard]] clock::time_point get_start_time() const {
+		return _start;
+	}
+private:
+	std::string _op;
+	std::string _mode;
+	std::uint64_t _total = 0;
+	clock::time_point _start;
+	std::optional<clock::time_point> _finish;
+	std::deque<telemetry_counters> _threads; // Elements of a deque do not move when more are added
+	mutable std::mutex _mutex;
+};
+
+// Registry of all tasks of the process, sampled by the reporter
+class telemetry {
+public:
+	// Registers a new task. The task stays valid until the program exits
+	[[nodiscard]] static telemetry_task &begin_task(std::string op, std::string mode, std::uint64_t total) {
+		telemetry &t = _get();
+		std::lock_guard<std::mutex> lock(t._mutex);
+		return t._tasks.emplace_back(std::move(op), std::move(mode), total);
+	}
+	// Registers a new task that covers the inputs of the shard result, which is unbounded if the campaign is
+	[[nodiscard]] static telemetry_task &begin_task(const shard_result &result) {
+		return begin_task(result.test, result.mode, result.total > 0 ? result.end - result.begin : 0);
+	}
+
+	// Calls the function with every registered task
+	template <typename Func> static void for_each_task(Func &&func) {
+		telemetry &t = _get();
+		std::lock_guard<std::mutex> lock(t._mutex);
+		for (const telemetry_task &task : t._tasks) {
+			func(task);
+		}
+	}
+private:
+	std::deque<telemetry_task> _tasks;
+	std::mutex _mutex;
+
+	[[nodiscard]] static telemetry &_get() {
+		static telemetry instance;
+		return instance;
+	}
+};
+
+// Starts a thread that reports all tasks every interval given by the shard spec, and once more when the reporter is
+// destroyed. Progress lines go to stderr so that they do not mix with test output. Metrics are written to the file
+// given by the spec, if any, by writing a temporary file and renaming it, so that a scraper never sees a partial file
+class telemetry_reporter {
+public:
+	explicit telemetry_reporter(const shard_spec &spec) :
+		_metrics_path(spec.metrics), _interval(spec.metrics_interval), _shard(_get_shard_name(spec)) {
+		_thread = std::thread([this]() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (!_stop) {
+				_stop_condition.wait_for(lock, _interval, [this]() {
+					return _stop;
+				});
+				_report(!_stop);
+			}
+		});
+	}
+	telemetry_reporter(const telemetry_reporter&) = delete;
+	telemetry_reporter &operator=(const telemetry_reporter&) = delete;
+	~telemetry_reporter() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_stop_condition.notify_one();
+		_thread.join();
+	}
+private:
+	// Counters of a task at the previous report, used to compute the current rates. Tasks are only ever added, so the
+	// samples are matched to tasks by index
+	struct previous_sample {
+		explicit previous_sample(telemetry_task::clock::time_point t) : time(t) {
+		}
+
+		std::vector<std::uint64_t> thread_samples;
+		std::uint64_t samples = 0;
+		telemetry_task::clock::time_point time;
+	};
+
+	// A metric and its samples for all tasks. The text format requires all samples of a metric to be written together
+	struct metric_family {
+		metric_family(std::string_view n, std::string_view t, std::string_view h) : name(n), type(t), help(h) {
+		}
+
+		std::string_view name;
+		std::string_view type;
+		std::string_view help;
+		std::string samples;
+	};
+
+	std::string _metrics_path;
+	std::chrono::duration<double> _interval;
+	std::string _shard;
+	std::vector<previous_sample> _previous;
+	std::thread _thread;
+	std::mutex _mutex;
+	std::condition_variable _stop_condition;
+	bool _stop = false;
+
+	[[nodiscard]] static std::string _get_shard_name(const shard_spec &spec) {
+		if (spec.range) {
+			return std::to_string(spec.range->first) + ":" + std::to_string(spec.range->second);
+		}
+		return std::to_string(spec.index) + "/" + std::to_string(spec.count);
+	}
+
+	// Formats a duration as hours, minutes and seconds
+	[[nodiscard]] static std::string _format_duration(double seconds) {
+		if (!std::isfinite(seconds)) {
+			return "unknown";
+		}
+		const auto total = static_cast<std::uint64_t>(seconds);
+		std::ostringstream out;
+		if (total >= 3600) {
+			out << total / 3600 << "h";
+		}
+		if (total >= 60) {
+			out << total / 60 % 60 << "m";
+		}
+		out << total % 60 << "s";
+		return out.str();
+	}
+	// Formats a value in the Prometheus text format, which spells infinity and NaN differently from iostreams
+	[[nodiscard]] static std::string _format_metric(std::uint64_t value) {
+		return std::to_string(value);
+	}
+	[[nodiscard]] static std::string _format_metric(double value) {
+		if (std::isnan(value)) {
+			return "NaN";
+		}
+		if (std::isinf(value)) {
+			return value > 0.0 ? "+Inf" : "-Inf";
+		}
+		std::ostringstream out;
+		out << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+		return out.str();
+	}
+
+	// Prints progress of running tasks if requested, and writes metrics of all tasks
+	void _report(bool print_progress) {
+		const telemetry_task::clock::time_point now = telemetry_task::clock::now();
+		std::ostringstream progress;
+		std::array<metric_family, 9> families{
+			metric_family{ "samples_total", "counter", "Number of inputs tested" },
+			metric_family{ "mismatches_total", "counter", "Number of inputs with mismatching results" },
+			metric_family{ "samples_per_second", "gauge", "Inputs tested per second since the previous report" },
+			metric_family{ "progress_ratio", "gauge", "Fraction of the inputs of the task tested, NaN if unbounded" },
+			metric_family{ "eta_seconds", "gauge", "Estimated time until the task finishes, NaN if unknown" },
+			metric_family{ "mismatch_ratio", "gauge", "Fraction of tested inputs with mismatching results" },
+			metric_family{ "running", "gauge", "1 if the task is running, 0 if it has finished" },
+			metric_family{ "thread_samples_total", "counter", "Number of inputs tested by a worker thread" },
+			metric_family{
+				"thread_samples_per_second", "gauge", "Inputs tested per second by a worker thread since the previous report"
+			}
+		};
+		auto add_sample = [&](std::string_view name, const std::string &labels, const auto &value) {
+			for (metric_family &family : families) {
+				if (family.name == name) {
+					family.samples += "float_testbed_" + std::string(name) + "{" + labels + "} " + _format_metric(value) + "\n";
+				}
+			}
+		};
+
+		std::size_t index = 0;
+		telemetry::for_each_task([&](const telemetry_task &task) {
+			const telemetry_task::snapshot snapshot = task.take_snapshot();
+			if (index >= _previous.size()) {
+				_previous.emplace_back(task.get_start_time());
+			}
+			previous_sample &previous = _previous[index];
+			++index;
+
+			const std::chrono::duration<double> elapsed = now - previous.time;
+			auto get_rate = [&](std::uint64_t current, std::uint64_t before) {
+				return elapsed.count() > 0.0 ? static_cast<double>(current - before) / elapsed.count() : 0.0;
+			};
+			const double rate = snapshot.running ? get_rate(snapshot.samples, previous.samples) : 0.0;
+			std::vector<double> thread_rates(snapshot.thread_samples.size(), 0.0);
+			for (std::size_t i = 0; i < thread_rates.size(); ++i) {
+				const std::uint64_t before = i < previous.thread_samples.size() ? previous.thread_samples[i] : 0;
+				thread_rates[i] = snapshot.running ? get_rate(snapshot.thread_samples[i], before) : 0.0;
+			}
+			const double nan = std::numeric_limits<double>::quiet_NaN();
+			const std::uint64_t total = task.get_total();
+			const double progress_ratio =
+				total > 0 ? static_cast<double>(snapshot.samples) / static_cast<double>(total) : nan;
+			// The ETA uses the average rate since the task started, which is steadier than the current rate
+			double eta = nan;
+			if (!snapshot.running) {
+				eta = 0.0;
+			} else if (total > 0 && snapshot.samples > 0) {
+				eta = snapshot.seconds * static_cast<double>(total - std::min(snapshot.samples, total)) /
+					static_cast<double>(snapshot.samples);
+			}
+			const double mismatch_ratio =
+				snapshot.samples > 0 ? static_cast<double>(snapshot.mismatches) / static_cast<double>(snapshot.samples) : 0.0;
+			previous.thread_samples = snapshot.thread_samples;
+			previous.samples = snapshot.samples;
+			previous.time = now;
+
+			if (print_progress && snapshot.running) {
+				progress << "[telemetry] " << task.get_op() << " (" << task.get_mode() << "): " << snapshot.samples;
+				if (total > 0) {
+					progress <<
+						"/" << total << " (" << std::fixed << std::setprecision(2) << 100.0 * progress_ratio << "%)" <<
+						std::defaultfloat;
+				}
+				progress << ", " << std::setprecision(4) << rate / 1e6 << " M/s";
+				if (total > 0) {
+					progress << ", ETA " << _format_duration(eta);
+				}
+				progress <<
+					", " << snapshot.mismatches << " mismatches (" << 1e6 * mismatch_ratio << " ppm), " <<
+					"elapsed " << _format_duration(snapshot.seconds);
+				if (thread_rates.size() > 1) {
+					progress << ", threads (M/s):";
+					for (const double thread_rate : thread_rates) {
+						progress << " " << thread_rate / 1e6;
+					}
+				}
+				progress << "\n";
+			}
+
+			const std::string labels =
+				"op=\"" + task.get_op() + "\",mode=\"" + task.get_mode() + "\",shard=\"" + _shard + "\"";
+			add_sample("samples_total", labels, snapshot.samples);
+			add_sample("mismatches_total", labels, snapshot.mismatches);
+			add_sample("samples_per_second", labels, rate);
+			add_sample("progress_ratio", labels, progress_ratio);
+			add_sample("eta_seconds", labels, eta);
+			add_sample("mismatch_ratio", labels, mismatch_ratio);
+			add_sample("running", labels, static_cast<std::uint64_t>(snapshot.running ? 1 : 0));
+			for (std::size_t i = 0; i < thread_rates.size(); ++i) {
+				const std::string thread_labels = labels + ",thread=\"" + std::to_string(i) + "\"";
+				add_sample("thread_samples_total", thread_labels, snapshot.thread_samples[i]);
+				add_sample("thread_samples_per_second", thread_labels, thread_rates[i]);
+			}
+		});
+
+		if (print_progress) {
+			std::cerr << progress.str() << std::flush;
+		}
+		if (!_metrics_path.empty()) {
+			const std::string temp_path = _metrics_path + ".tmp";
+			{
+				std::ofstream fout(temp_path);
+				for (const metric_family &family : families) {
+					fout <<
+						"# HELP float_testbed_" << family.name << " " << family.help << "\n" <<
+						"# TYPE float_testbed_" << family.name << " " << family.type << "\n" <<
+						family.samples;
+				}
+				if (!fout) {
+					std::cerr << "Failed to write metrics to " << temp_path << "\n";
+					return;
+				}
+			}
+			std::error_code error;
+			std::filesystem::rename(temp_path, _metrics_path, error);
+			if (error) {
+				std::cerr << "Failed to write metrics to " << _metrics_path << ": " << error.message() << "\n";
+			}
+		}
+	}
+};
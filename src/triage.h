@@ -0,0 +1,394 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "float_utils/float_parts.h"
+#include "float_utils/instrumentation.h"
+
+// Triage of mismatches found by fuzzing a binary operator. Each failing input is replayed with path instrumentation.
+// Mismatches that take the same rounding branches and have errors of the same shape most likely share a cause, so they
+// are grouped into one cluster, and only the simplest input of each cluster is reported. If a reference implementation
+// is available, that input is also shrunk to a simpler one that still fails in the same way. Within a cluster, the
+// other paths taken and the exponent differences of the operands are broken down, so that paths taken by every mismatch
+// of the cluster stand out
+
+static_assert(float_utils::num_operator_paths <= 32, "Paths taken by an input are stored in a 32-bit mask");
+
+// Classification of one mismatch that decides its cluster
+struct mismatch_class {
+	// Bit i is set if the rounding path with index i is taken by the software implementation
+	std::uint32_t rounding_paths = 0;
+	// Bucket of the distance between the results in ulps: 0, 1, 2, then (2^k, 2^(k+1)] for k >= 1. It is 0 if either
+	// result is NaN, or if the results are zeros of different signs
+	std::uint32_t ulp_bucket = 0;
+	// Whether the result has a larger magnitude than the expected result
+	bool away_from_zero = false;
+	// Whether the results have different signs
+	bool sign_differs = false;
+	// Whether exactly one of the results is NaN
+	bool nan = false;
+
+	[[nodiscard]] friend auto operator<=>(const mismatch_class&, const mismatch_class&) = default;
+};
+
+namespace triage::_details {
+	// Maps floats to integers so that adjacent floats map to adjacent integers, with both zeros mapped to 0
+	[[nodiscard]] constexpr std::int64_t to_ordered(float f) {
+		const auto bits = static_cast<std::int64_t>(std::bit_cast<std::uint32_t>(f) & ~float_parts::sign_mask);
+		return float_parts::get_sign(f) ? -bits : bits;
+	}
+
+	// Bucket of a non-negative value, so that the buckets are 0, 1, 2, 3-4, 5-8, and so on
+	[[nodiscard]] constexpr std::uint32_t get_bucket(std::uint64_t value) {
+		return value <= 2 ? static_cast<std::uint32_t>(value) : static_cast<std::uint32_t>(std::bit_width(value - 1)) + 1;
+	}
+	[[nodiscard]] inline std::string get_bucket_range(std::uint32_t bucket) {
+		if (bucket <= 2) {
+			return std::to_string(bucket);
+		}
+		return std::to_string((1ull << (bucket - 2)) + 1) + "-" + std::to_string(1ull << (bucket - 1));
+	}
+	static_assert(get_bucket(3) == 3 && get_bucket(4) == 3 && get_bucket(5) == 4 && get_bucket(8) == 4);
+
+	// Exponent of the operand, with subnormals treated as having the smallest normal exponent
+	[[nodiscard]] constexpr std::int32_t get_triage_exponent(float x) {
+		return std::max<std::int32_t>(float_parts::get_offset_exponent(x), 1 - float_parts::exponent_offset);
+	}
+
+	// Distance of the biased exponent of the value to the exponent of 1
+	[[nodiscard]] constexpr std::uint32_t get_exponent_distance(float x) {
+		const std::uint32_t exponent = float_parts::get_exponent(x);
+		return exponent > float_parts::exponent_offset ?
+			exponent - float_parts::exponent_offset : float_parts::exponent_offset - exponent;
+	}
+	// Return the value with its biased exponent increased or decreased by the given step, or std::nullopt if the value
+	// is infinite or NaN, or if the exponent would leave the range of finite values
+	[[nodiscard]] constexpr std::optional<float> move_exponent_up(float x, std::uint32_t step) {
+		constexpr std::uint32_t max_exponent = float_parts::exponent_mask >> float_parts::num_fraction_bits;
+		const std::uint32_t exponent = float_parts::get_exponent(x);
+		if (exponent == max_exponent || step >= max_exponent - exponent) {
+			return std::nullopt;
+		}
+		return float_parts::assemble(float_parts::get_sign(x), exponent + step, float_parts::get_fraction(x));
+	}
+	[[nodiscard]] constexpr std::optional<float> move_exponent_down(float x, std::uint32_t step) {
+		constexpr std::uint32_t max_exponent = float_parts::exponent_mask >> float_parts::num_fraction_bits;
+		const std::uint32_t exponent = float_parts::get_exponent(x);
+		if (exponent == max_exponent || step > exponent) {
+			return std::nullopt;
+		}
+		return float_parts::assemble(float_parts::get_sign(x), exponent - step, float_parts::get_fraction(x));
+	}
+	// Returns the value with its biased exponent moved toward the exponent of 1 by the given step, or std::nullopt if
+	// the step is larger than the distance
+	[[nodiscard]] constexpr std::optional<float> move_exponent(float x, std::uint32_t step) {
+		if (step > get_exponent_distance(x)) {
+			return std::nullopt;
+		}
+		return float_parts::get_exponent(x) > float_parts::exponent_offset ?
+			move_exponent_down(x, step) : move_exponent_up(x, step);
+	}
+
+	[[nodiscard]] constexpr bool is_rounding_path(std::size_t path) {
+		return float_utils::get_operator_path_name(static_cast<float_utils::operator_path>(path)).starts_with("round_");
+	}
+}
+
+// Collects mismatches of one operator and rounding mode, and groups them into clusters
+class mismatch_triage {
+public:
+	// The software implementation should be instrumented using float_utils::path_counters. Replaying and shrinking
+	// inputs also count their paths in the counters of the calling thread. The reference implementation is used to shrink the
+	// representatives of clusters; they are not shrunk if it is empty
+	explicit mismatch_triage(
+		std::function<float(float, float)> my_ver, std::function<float(float, float)> reference = nullptr
+	) : _my_ver(std::move(my_ver)), _reference(std::move(reference)) {
+	}
+
+	// Replays a failing input and adds it to its cluster. Returns false if the input no longer fails
+	bool add(float x, float y, float expected) {
+		const std::optional<replay> r = _replay(x, y, expected);
+		if (!r) {
+			return false;
+		}
+		_add(x, y, expected, r.value());
+		return true;
+	}
+	// Adds a failing input whose result and taken paths have already been observed, without replaying it. Bit i of
+	// paths is set if the path with index i has been taken. Returns false if the input does not fail
+	bool add(float x, float y, float expected, float actual, std::uint32_t paths) {
+		const std::optional<replay> r = _classify(expected, actual, paths);
+		if (!r) {
+			return false;
+		}
+		_add(x, y, expected, r.value());
+		return true;
+	}
+
+	[[nodiscard]] std::uint64_t get_num_mismatches() const {
+		return _num_mismatches;
+	}
+	[[nodiscard]] std::size_t get_num_clusters() const {
+		return _clusters.size();
+	}
+
+	// Writes all clusters from the largest to the smallest. The representative of each cluster is also written as a
+	// line that starts with "repro", followed by the operator, the rounding mode, and the bit patterns of the operands,
+	// the expected result and the actual result
+	void write_report(std::ostream &out, std::string_view operator_name, std::string_view mode_name) const {
+		std::vector<std::pair<const mismatch_class*, const cluster*>> sorted;
+		for (const auto &[cls, c] : _clusters) {
+			sorted.emplace_back(&cls, &c);
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), [](const auto &lhs, const auto &rhs) {
+			return lhs.second->count > rhs.second->count;
+		});
+
+		auto percentage = [](std::uint64_t count, std::uint64_t total) {
+			return 100.0 * static_cast<double>(count) / static_cast<double>(total);
+		};
+		auto get_path_name = [](std::size_t path) {
+			return float_utils::get_operator_path_name(static_cast<float_utils::operator_path>(path));
+		};
+
+		out <<
+			"Triage of " << operator_name << " (" << mode_name << "): " << _num_mismatches << " mismatches in " <<
+			_clusters.size() << " clusters\n";
+		for (std::size_t i = 0; i < sorted.size(); ++i) {
+			const mismatch_class &cls = *sorted[i].first;
+			const cluster &c = *sorted[i].second;
+			const input &rep = c.representative;
+			out <<
+				"  Cluster " << i + 1 << ": " << c.count << " mismatches (" << percentage(c.count, _num_mismatches) << "%)\n" <<
+				"    Rounding paths:";
+			if (cls.rounding_paths == 0) {
+				out << " none";
+			}
+			for (std::size_t p = 0; p < float_utils::num_operator_paths; ++p) {
+				if ((cls.rounding_paths >> p) & 1) {
+					out << " " << get_path_name(p);
+				}
+			}
+			out << "\n    Error: ";
+			if (cls.nan) {
+				out << (std::isnan(rep.actual) ? "NaN instead of a number" : "number instead of NaN");
+			} else {
+				out <<
+					triage::_details::get_bucket_range(cls.ulp_bucket) << " ulps " <<
+					(cls.away_from_zero ? "away from zero" : "toward zero") <<
+					(cls.sign_differs ? ", with the wrong sign" : "");
+			}
+
+			std::ostringstream taken_by_all;
+			std::ostringstream taken_by_some;
+			for (std::size_t p = 0; p < float_utils::num_operator_paths; ++p) {
+				if (triage::_details::is_rounding_path(p) || c.path_hits[p] == 0) {
+					continue;
+				}
+				if (c.path_hits[p] == c.count) {
+					taken_by_all << " " << get_path_name(p);
+				} else {
+					taken_by_some << " " << get_path_name(p) << " (" << percentage(c.path_hits[p], c.count) << "%)";
+				}
+			}
+			out <<
+				"\n    Taken by all:" << (taken_by_all.view().empty() ? " none" : taken_by_all.view()) <<
+				"\n    Taken by some:" << (taken_by_some.view().empty() ? " none" : taken_by_some.view());
+			out << "\n    Exponent differences:";
+			for (const auto &[bucket, count] : c.exponent_differences) {
+				out << " " << triage::_details::get_bucket_range(bucket) << " (" << percentage(count, c.count) << "%)";
+			}
+
+			out <<
+				"\n    Representative: " << std::hexfloat << rep.x << " " << operator_name << " " << rep.y <<
+				": expected " << rep.expected << ", got " << rep.actual << std::defaultfloat << "\n" <<
+				"    repro " << operator_name << " " << mode_name << " " << std::hex <<
+				std::bit_cast<std::uint32_t>(rep.x) << " " << std::bit_cast<std::uint32_t>(rep.y) << " " <<
+				std::bit_cast<std::uint32_t>(rep.expected) << " " << std::bit_cast<std::uint32_t>(rep.actual) << std::dec <<
+				"\n";
+		}
+	}
+private:
+	// A failing input with its expected and actual results
+	struct input {
+		float x = 0.0f;
+		float y = 0.0f;
+		float expected = 0.0f;
+		float actual = 0.0f;
+	};
+	// Mismatches with the same classification, and the simplest input among them after shrinking
+	struct cluster {
+		std::uint64_t count = 0;
+		std::array<std::uint64_t, float_utils::num_operator_paths> path_hits{};
+		std::map<std::uint32_t, std::uint64_t> exponent_differences; // Number of mismatches in each bucket
+		input representative;
+	};
+	// Result of replaying a failing input
+	struct replay {
+		mismatch_class cls;
+		std::uint32_t paths = 0; // Bit i is set if the path with index i is taken
+		float actual = 0.0f;
+	};
+
+	constexpr static std::uint32_t _rounding_path_mask = []() {
+		std::uint32_t mask = 0;
+		for (std::size_t i = 0; i < float_utils::num_operator_paths; ++i) {
+			if (triage::_details::is_rounding_path(i)) {
+				mask |= 1u << i;
+			}
+		}
+		return mask;
+	}();
+
+	std::function<float(float, float)> _my_ver;
+	std::function<float(float, float)> _reference;
+	std::map<mismatch_class, cluster> _clusters;
+	std::uint64_t _num_mismatches = 0;
+
+	// Adds a classified mismatch to its cluster
+	void _add(float x, float y, float expected, const replay &r) {
+		cluster &c = _clusters[r.cls];
+		++c.count;
+		for (std::size_t i = 0; i < float_utils::num_operator_paths; ++i) {
+			c.path_hits[i] += (r.paths >> i) & 1;
+		}
+		++c.exponent_differences[triage::_details::get_bucket(static_cast<std::uint64_t>(
+			std::abs(triage::_details::get_triage_exponent(x) - triage::_details::get_triage_exponent(y))
+		))];
+		// Shrinking never makes an input more complex, so inputs that are not simpler than the representative before
+		// shrinking are not shrunk
+		if (c.count == 1 || _get_complexity(x, y) < _get_complexity(c.representative.x, c.representative.y)) {
+			c.representative = _shrink({ x, y, expected, r.actual }, r.cls);
+		}
+		++_num_mismatches;
+	}
+
+	// Replays an input and classifies the mismatch. Returns std::nullopt if the input does not fail
+	[[nodiscard]] std::optional<replay> _replay(float x, float y, float expected) const {
+		const float_utils::path_counters::counters before = float_utils::path_counters::snapshot();
+		const float actual = _my_ver(x, y);
+		const float_utils::path_counters::counters after = float_utils::path_counters::snapshot();
+		std::uint32_t paths = 0;
+		for (std::size_t i = 0; i < float_utils::num_operator_paths; ++i) {
+			if (after[i] != before[i]) {
+				paths |= 1u << i;
+			}
+		}
+		return _classify(expected, actual, paths);
+	}
+
+	// Classifies the mismatch between the expected and the actual result. Returns std::nullopt if they match
+	[[nodiscard]] static std::optional<replay> _classify(float expected, float actual, std::uint32_t paths) {
+		const bool expected_nan = std::isnan(expected);
+		const bool actual_nan = std::isnan(actual);
+		if (expected_nan && actual_nan) {
+			return std::nullopt;
+		}
+		if (!expected_nan && !actual_nan && std::bit_cast<std::uint32_t>(expected) == std::bit_cast<std::uint32_t>(actual)) {
+			return std::nullopt;
+		}
+
+		replay result;
+		result.actual = actual;
+		result.paths = paths;
+		result.cls.rounding_paths = result.paths & _rounding_path_mask;
+		result.cls.nan = expected_nan != actual_nan;
+		if (!result.cls.nan) {
+			const std::int64_t ulps = triage::_details::to_ordered(actual) - triage::_details::to_ordered(expected);
+			result.cls.ulp_bucket = triage::_details::get_bucket(static_cast<std::uint64_t>(std::abs(ulps)));
+			result.cls.away_from_zero = std::abs(actual) > std::abs(expected);
+			result.cls.sign_differs = std::signbit(actual) != std::signbit(expected);
+		}
+		return result;
+	}
+
+	// Shrinks a failing input by clearing fraction bits of the operands and moving their exponents toward 0, as long as
+	// it still fails with the same classification. Every accepted step makes the input simpler, so shrinking ends
+	[[nodiscard]] input _shrink(input rep, const mismatch_class &cls) const {
+		if (!_reference) {
+			return rep;
+		}
+		auto try_operands = [&](float x, float y) {
+			if (_get_complexity(x, y) >= _get_complexity(rep.x, rep.y)) {
+				return false;
+			}
+			const float expected = _reference(x, y);
+			const std::optional<replay> r = _replay(x, y, expected);
+			if (!r || r->cls != cls) {
+				return false;
+			}
+			rep = { x, y, expected, r->actual };
+			return true;
+		};
+		// Tries to move exponents by the distance of the given operand to 0 first, then by smaller and smaller steps.
+		// try_step returns whether the input with exponents moved by the step has been accepted
+		auto shrink_exponents = [&](const float &operand, auto &&try_step) {
+			bool shrunk = false;
+			for (bool moved = true; moved; ) {
+				moved = false;
+				const std::uint32_t distance = triage::_details::get_exponent_distance(operand);
+				for (std::uint32_t step = distance; step > 0 && !moved; step /= 2) {
+					moved = try_step(step);
+				}
+				shrunk = moved || shrunk;
+			}
+			return shrunk;
+		};
+
+		for (bool shrunk = true; shrunk; ) {
+			shrunk = false;
+			for (float *operand : { &rep.x, &rep.y }) {
+				auto try_operand = [&](float value) {
+					return operand == &rep.x ? try_operands(value, rep.y) : try_operands(rep.x, value);
+				};
+				for (std::uint32_t bit = float_parts::num_fraction_bits; bit-- > 0; ) {
+					const auto bits = std::bit_cast<std::uint32_t>(*operand);
+					if ((bits >> bit) & 1) {
+						shrunk = try_operand(std::bit_cast<float>(bits & ~(1u << bit))) || shrunk;
+					}
+				}
+				shrunk = shrink_exponents(*operand, [&](std::uint32_t step) {
+					const std::optional<float> moved = triage::_details::move_exponent(*operand, step);
+					return moved && try_operand(moved.value());
+				}) || shrunk;
+			}
+			// Moving both exponents together keeps their difference, which often decides whether an input fails
+			shrunk = shrink_exponents(rep.x, [&](std::uint32_t step) {
+				const std::optional<float> x = triage::_details::move_exponent(rep.x, step);
+				// y moves in the same direction as x
+				const bool toward_larger = float_parts::get_exponent(rep.x) < float_parts::exponent_offset;
+				const std::optional<float> y = toward_larger ?
+					triage::_details::move_exponent_up(rep.y, step) : triage::_details::move_exponent_down(rep.y, step);
+				return x && y && try_operands(x.value(), y.value());
+			}) || shrunk;
+		}
+		return rep;
+	}
+
+	// Inputs with fewer fraction bits set, then with exponents closer to 0, are easier to reason about
+	[[nodiscard]] static std::tuple<int, std::uint32_t, std::uint32_t> _get_complexity(float x, float y) {
+		const int fraction_bits =
+			std::popcount(float_parts::get_fraction(x)) + std::popcount(float_parts::get_fraction(y));
+		const auto exponents = static_cast<std::uint32_t>(
+			std::abs(float_parts::get_offset_exponent(x)) + std::abs(float_parts::get_offset_exponent(y))
+		);
+		const std::uint32_t bits =
+			(std::bit_cast<std::uint32_t>(x) & ~float_parts::sign_mask) +
+			(std::bit_cast<std::uint32_t>(y) & ~float_parts::sign_mask);
+		return { fraction_bits, exponents, bits };
+	}
+};